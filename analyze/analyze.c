@@ -0,0 +1,440 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "config.h"
+#include "engine.h"
+#include "protocol.h"
+#include "util.h"
+
+#define ANALYZE_MAXLINE     PROTOCOL_MAXLINE
+#define ANALYZE_RESULT_LEN  4096
+#define ANALYZE_MOVES_LEN   (ROWS*COLUMNS*BOARD_ID_STR_LEN)
+#define ANALYZE_PATH_LEN    4096
+#define ANALYZE_TREE_VISITS 16
+#define ANALYZE_GAME_LINES  (ROWS*COLUMNS + 1)
+
+typedef enum AnalyzeFormat
+{
+    ANALYZE_JSONL   = 0,
+    ANALYZE_CSV     = 1,
+}
+eAnalyzeFormat;
+
+typedef struct AnalyzeLine
+{
+    uint64_t Line;
+    int Parsed;
+    tProtocolRequest Request;
+}
+tAnalyzeLine;
+
+typedef struct Analyze
+{
+    FILE *pIn;
+    FILE *pOut;
+    pthread_mutex_t InMutex;
+    pthread_mutex_t OutMutex;
+    uint64_t Line;
+    tAnalyzeLine Next;
+    bool Peeked;
+    tEngineConfig Config;
+    tEngineBudget Budget;
+    eAnalyzeFormat Format;
+    const char *pTrees;
+    uint64_t Failures;
+}
+tAnalyze;
+
+static void *analyze_work(void *pArg);
+static int analyze_read(tAnalyze *pAnalyze, tAnalyzeLine *pLines);
+static bool analyze_continues(const tAnalyzeLine *pLast, const tAnalyzeLine *pLine);
+static void analyze_position(tAnalyze *pAnalyze, tEngine *pEngine, const tAnalyzeLine *pLine);
+static void analyze_moves(char *pStr, const int *pMoves, int Size);
+static void analyze_tree_path(char *pPath, const char *pTrees, const tProtocolRequest *pRequest);
+static void analyze_usage(const char *pName);
+
+/*
+ * Reads one position per line, a ruleset followed by its moves as in
+ * STARTING_MOVES, e.g. "2 d4 c3 e5", and writes one result per line in the
+ * order the positions finish. Blank lines and lines starting with "#" are
+ * skipped. Each worker keeps one engine and takes a run of lines in which every
+ * position continues the one before it, as when analyzing every move of a game,
+ * so that the positions of one game reuse its tree. With only a time limit, the
+ * search is not limited by the configured simulations. With a tree directory,
+ * each position starts from the tree saved by an earlier run and saves its tree
+ * when done, so the simulations count the visits kept from that run.
+ */
+int main(int argc, char **argv)
+{
+    int Res = 0, Option;
+    long Workers = sysconf(_SC_NPROCESSORS_ONLN);
+    tAnalyze Analyze;
+    tConfig Config;
+    pthread_t *pWorkers;
+
+    memset(&Analyze, 0, sizeof(Analyze));
+
+    Analyze.pIn = stdin;
+    Analyze.pOut = stdout;
+    Analyze.Format = ANALYZE_JSONL;
+
+    while ((Option = getopt(argc, argv, "s:t:j:f:T:")) ISNOT -1)
+    {
+        if (Option == 's' AND atol(optarg) > 0)
+        {
+            Analyze.Budget.Simulations = atol(optarg);
+        }
+        else if (Option == 't' AND atol(optarg) > 0)
+        {
+            Analyze.Budget.TimeMs = atol(optarg);
+        }
+        else if (Option == 'j' AND atol(optarg) > 0)
+        {
+            Workers = atol(optarg);
+        }
+        else if (Option == 'f' AND (strcmp(optarg, "jsonl") == 0 OR strcmp(optarg, "csv") == 0))
+        {
+            Analyze.Format = IF (strcmp(optarg, "csv") == 0) THEN ANALYZE_CSV ELSE ANALYZE_JSONL;
+        }
+        else if (Option == 'T' AND strlen(optarg) < ANALYZE_PATH_LEN - 2*ANALYZE_MOVES_LEN)
+        {
+            Analyze.pTrees = optarg;
+        }
+        else
+        {
+            analyze_usage(argv[0]);
+            Res = -EINVAL;
+            goto Error;
+        }
+    }
+
+    if (Analyze.Budget.TimeMs > 0 AND Analyze.Budget.Simulations == 0)
+    {
+        Analyze.Budget.Simulations = UINT32_MAX;
+    }
+
+    if (optind < argc AND (Analyze.pIn = fopen(argv[optind], "r")) IS NULL)
+    {
+        fprintf(stderr, "[ERROR] Cannot open file \"%s\"\n", argv[optind]);
+        Res = -errno;
+        goto Error;
+    }
+
+    Res = config_init(&Config);
+    if (Res < 0)
+    {
+        goto CloseIn;
+    }
+
+    Res = config_load(&Config);
+    if (Res < 0)
+    {
+        goto FreeConfig;
+    }
+
+    config_engine(&Config, &Analyze.Config);
+
+    pthread_mutex_init(&Analyze.InMutex, NULL);
+    pthread_mutex_init(&Analyze.OutMutex, NULL);
+
+    if (Analyze.Format == ANALYZE_CSV)
+    {
+        fprintf(Analyze.pOut, "line,rules,moves,bestmove,eval,simulations,visits,error\n");
+    }
+
+    pWorkers = emalloc(Workers * sizeof(pthread_t));
+
+    for (long i = 0; i < Workers; ++i)
+    {
+        if (pthread_create(&pWorkers[i], NULL, analyze_work, &Analyze) ISNOT 0)
+        {
+            fprintf(stderr, "[ERROR] Cannot start worker thread\n");
+            Analyze.Failures++;
+            Workers = i;
+        }
+    }
+
+    for (long i = 0; i < Workers; ++i)
+    {
+        pthread_join(pWorkers[i], NULL);
+    }
+
+    free(pWorkers);
+    pthread_mutex_destroy(&Analyze.InMutex);
+    pthread_mutex_destroy(&Analyze.OutMutex);
+
+    if (Analyze.Failures > 0)
+    {
+        fprintf(stderr, "[ERROR] %lu positions or workers failed\n", (unsigned long) Analyze.Failures);
+        Res = -EINVAL;
+    }
+
+FreeConfig:
+    config_free(&Config);
+
+CloseIn:
+    if (Analyze.pIn ISNOT stdin)
+    {
+        fclose(Analyze.pIn);
+    }
+
+Error:
+    return IF (Res < 0) THEN EXIT_FAILURE ELSE EXIT_SUCCESS;
+}
+
+static void *analyze_work(void *pArg)
+{
+    tAnalyze *pAnalyze = pArg;
+    tEngine *pEngine;
+    tAnalyzeLine *pLines;
+    int Size;
+
+    if (engine_create(&pEngine, &pAnalyze->Config) < 0)
+    {
+        pthread_mutex_lock(&pAnalyze->OutMutex);
+        fprintf(stderr, "[ERROR] Cannot create engine\n");
+        pAnalyze->Failures++;
+        pthread_mutex_unlock(&pAnalyze->OutMutex);
+        goto Error;
+    }
+
+    pLines = emalloc(ANALYZE_GAME_LINES * sizeof(tAnalyzeLine));
+
+    while ((Size = analyze_read(pAnalyze, pLines)) > 0)
+    {
+        for (int i = 0; i < Size; ++i)
+        {
+            analyze_position(pAnalyze, pEngine, &pLines[i]);
+        }
+    }
+
+    free(pLines);
+    engine_free(pEngine);
+
+Error:
+    return NULL;
+}
+
+/*
+ * Reads the positions of one game, each continuing the one before it. The first
+ * position that does not is kept for the next read.
+ */
+static int analyze_read(tAnalyze *pAnalyze, tAnalyzeLine *pLines)
+{
+    int Size = 0;
+    char Position[ANALYZE_MAXLINE];
+
+    pthread_mutex_lock(&pAnalyze->InMutex);
+
+    if (pAnalyze->Peeked)
+    {
+        pLines[Size++] = pAnalyze->Next;
+        pAnalyze->Peeked = false;
+    }
+
+    while (Size < ANALYZE_GAME_LINES AND NOT pAnalyze->Peeked
+        AND fgets(Position, sizeof(Position), pAnalyze->pIn) ISNOT NULL)
+    {
+        tAnalyzeLine *pLine = &pLines[Size];
+        size_t Start;
+
+        pLine->Line = ++pAnalyze->Line;
+        Position[strcspn(Position, "\r\n")] = '\0';
+        Start = strspn(Position, " \t");
+
+        if (Position[Start] == '\0' OR Position[Start] == '#')
+        {
+            continue;
+        }
+
+        memset(&pLine->Request, 0, sizeof(pLine->Request));
+        pLine->Parsed = protocol_parse_position(Position, &pLine->Request);
+
+        if (Size == 0 OR analyze_continues(&pLines[Size - 1], pLine))
+        {
+            Size++;
+        }
+        else
+        {
+            pAnalyze->Next = *pLine;
+            pAnalyze->Peeked = true;
+        }
+    }
+
+    pthread_mutex_unlock(&pAnalyze->InMutex);
+
+    return Size;
+}
+
+static bool analyze_continues(const tAnalyzeLine *pLast, const tAnalyzeLine *pLine)
+{
+    return pLast->Parsed == 0 AND pLine->Parsed == 0 AND pLast->Request.RulesType == pLine->Request.RulesType
+        AND pLast->Request.Size <= pLine->Request.Size
+        AND memcmp(pLast->Request.Moves, pLine->Request.Moves, pLast->Request.Size * sizeof(int)) == 0;
+}
+
+/*
+ * Positions that are decided before any simulation, by the opening move or the
+ * endgame solver, have no evaluation. Finished games are reported, but are not
+ * counted as failures.
+ */
+static void analyze_position(tAnalyze *pAnalyze, tEngine *pEngine, const tAnalyzeLine *pLine)
+{
+    const tProtocolRequest *pRequest = &pLine->Request;
+    uint64_t Line = pLine->Line;
+    tEngineStats Stats;
+    tEngineChild Children[ROWS*COLUMNS];
+    char Result[ANALYZE_RESULT_LEN], Moves[ANALYZE_MOVES_LEN], Path[ANALYZE_PATH_LEN], Id[BOARD_ID_STR_LEN] = "";
+    const char *pError = NULL;
+    int Best = -EINVAL, Size = 0, Length = 0;
+    bool Finished = false;
+
+    memset(&Stats, 0, sizeof(Stats));
+
+    if (pLine->Parsed < 0 OR protocol_position(pEngine, pRequest) < 0)
+    {
+        pError = "invalid position";
+    }
+    else if ((Finished = engine_finished(pEngine)))
+    {
+        pError = "game finished";
+    }
+    else
+    {
+        if (pAnalyze->pTrees ISNOT NULL)
+        {
+            analyze_tree_path(Path, pAnalyze->pTrees, pRequest);
+            engine_load_tree(pEngine, Path);
+        }
+
+        if ((Best = engine_search(pEngine, &pAnalyze->Budget)) < 0)
+        {
+            pError = "search failed";
+        }
+        else
+        {
+            engine_stats(pEngine, &Stats);
+            Size = engine_children(pEngine, Children, ROWS*COLUMNS);
+            board_index_id_to_buf(Best, Id, sizeof(Id));
+
+            if (pAnalyze->pTrees ISNOT NULL AND Stats.Simulations > 0
+                AND engine_save_tree(pEngine, Path, 0, ANALYZE_TREE_VISITS) < 0)
+            {
+                pError = "cannot save tree";
+            }
+        }
+    }
+
+    analyze_moves(Moves, pRequest->Moves, pRequest->Size);
+
+    if (pAnalyze->Format == ANALYZE_CSV)
+    {
+        Length += snprintf(Result + Length, sizeof(Result) - Length, "%lu,%d,%s,%s,", (unsigned long) Line,
+            pRequest->RulesType, Moves, Id);
+
+        if (pError IS NULL AND Stats.Simulations > 0)
+        {
+            Length += snprintf(Result + Length, sizeof(Result) - Length, "%.4f", Stats.Eval);
+        }
+
+        Length += snprintf(Result + Length, sizeof(Result) - Length, ",%u,", Stats.Simulations);
+
+        for (int i = 0; i < Size; ++i)
+        {
+            char ChildId[BOARD_ID_STR_LEN];
+
+            board_index_id_to_buf(Children[i].Index, ChildId, sizeof(ChildId));
+            Length += snprintf(Result + Length, sizeof(Result) - Length, "%s%s:%u", IF (i > 0) THEN " " ELSE "",
+                ChildId, Children[i].Visits);
+        }
+
+        snprintf(Result + Length, sizeof(Result) - Length, ",%s", IF (pError ISNOT NULL) THEN pError ELSE "");
+    }
+    else if (pError ISNOT NULL)
+    {
+        snprintf(Result, sizeof(Result), "{\"line\":%lu,\"rules\":%d,\"moves\":\"%s\",\"error\":\"%s\"}",
+            (unsigned long) Line, pRequest->RulesType, Moves, pError);
+    }
+    else
+    {
+        Length += snprintf(Result + Length, sizeof(Result) - Length,
+            "{\"line\":%lu,\"rules\":%d,\"moves\":\"%s\",\"bestmove\":\"%s\",\"eval\":",
+            (unsigned long) Line, pRequest->RulesType, Moves, Id);
+
+        Length += IF (Stats.Simulations > 0) THEN snprintf(Result + Length, sizeof(Result) - Length, "%.4f", Stats.Eval)
+            ELSE snprintf(Result + Length, sizeof(Result) - Length, "null");
+
+        Length += snprintf(Result + Length, sizeof(Result) - Length, ",\"simulations\":%u,\"children\":[", Stats.Simulations);
+
+        for (int i = 0; i < Size; ++i)
+        {
+            char ChildId[BOARD_ID_STR_LEN];
+
+            board_index_id_to_buf(Children[i].Index, ChildId, sizeof(ChildId));
+            Length += snprintf(Result + Length, sizeof(Result) - Length, "%s{\"move\":\"%s\",\"visits\":%u,\"score\":%.4f}",
+                IF (i > 0) THEN "," ELSE "", ChildId, Children[i].Visits, Children[i].Score);
+        }
+
+        snprintf(Result + Length, sizeof(Result) - Length, "]}");
+    }
+
+    pthread_mutex_lock(&pAnalyze->OutMutex);
+
+    fprintf(pAnalyze->pOut, "%s\n", Result);
+    fflush(pAnalyze->pOut);
+
+    if (pError ISNOT NULL AND NOT Finished)
+    {
+        pAnalyze->Failures++;
+    }
+
+    pthread_mutex_unlock(&pAnalyze->OutMutex);
+}
+
+static void analyze_moves(char *pStr, const int *pMoves, int Size)
+{
+    size_t Length = 0;
+
+    *pStr = '\0';
+
+    for (int i = 0; i < Size; ++i)
+    {
+        char Id[BOARD_ID_STR_LEN];
+
+        board_index_id_to_buf(pMoves[i], Id, sizeof(Id));
+        bprintf(pStr, ANALYZE_MOVES_LEN, &Length, "%s%s", Id, IF (i < Size - 1) THEN " " ELSE "");
+    }
+}
+
+/*
+ * Trees are named after the ruleset and moves, e.g. "2-d4-c3.tree".
+ */
+static void analyze_tree_path(char *pPath, const char *pTrees, const tProtocolRequest *pRequest)
+{
+    size_t Length = 0;
+
+    *pPath = '\0';
+    bprintf(pPath, ANALYZE_PATH_LEN, &Length, "%s/%d", pTrees, pRequest->RulesType);
+
+    for (int i = 0; i < pRequest->Size; ++i)
+    {
+        char Id[BOARD_ID_STR_LEN];
+
+        board_index_id_to_buf(pRequest->Moves[i], Id, sizeof(Id));
+        bprintf(pPath, ANALYZE_PATH_LEN, &Length, "-%s", Id);
+    }
+
+    bprintf(pPath, ANALYZE_PATH_LEN, &Length, ".tree");
+}
+
+static void analyze_usage(const char *pName)
+{
+    fprintf(stderr, "Usage: %s [-s simulations] [-t milliseconds] [-j workers] [-f jsonl|csv] [-T tree directory] [file]\n", pName);
+}
@@ -0,0 +1,344 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bitutil.h"
+#include "board.h"
+#include "pathfinder.h"
+#include "random.h"
+#include "rules.h"
+#include "scorer.h"
+#include "types.h"
+#include "util.h"
+
+#define BENCH_DEFAULT_BOARDS    2000
+#define BENCH_RULES_TYPES       7
+#define BENCH_CORPORA           (BENCH_RULES_TYPES + 3)
+#define BENCH_BACKENDS          5
+#define BENCH_TRAIN_LENGTH      25
+#define BENCH_SHORT_MIN_LENGTH  5
+#define BENCH_SHORT_MAX_LENGTH  9
+#define BENCH_SHORT_AREA        (ROWS*COLUMNS - BENCH_SHORT_MAX_LENGTH)
+#define BENCH_TRAINS_DIVISOR    10
+#define BENCH_BATCH_SIZE        64
+#define BENCH_SEED_0            0x9E3779B97F4A7C15ULL
+#define BENCH_SEED_1            0xD1B54A32D192ED03ULL
+
+typedef struct BenchBackend
+{
+    const char *pName;
+    tBoardLongestPath LongestPath;
+    bool Adversarial;
+    bool Batch;
+}
+tBenchBackend;
+
+typedef struct BenchCorpus
+{
+    char Name[32];
+    tBoard *pBoards;
+    int Size;
+    bool Adversarial;
+}
+tBenchCorpus;
+
+static tSize bench_pathfinder(uint64_t Data, tIndex Index, uint64_t *pArea);
+
+static const tBenchBackend BenchBackends[BENCH_BACKENDS] = {
+    { "recursive",  board_index_longest_path,   false,  false },
+    { "lookup",     scorer_longest_path,        true,   false },
+    { "pathfinder", bench_pathfinder,           true,   false },
+    { "default",    NULL,                       true,   false },
+    { "batch",      NULL,                       true,   true },
+};
+
+static uint32_t BenchCapped = 0;
+
+static const char *BenchRulesNames[BENCH_RULES_TYPES] = {
+    "classical", "modern", "postmodern", "spanish", "swiss", "viennese", "mallorcan",
+};
+
+static void bench_corpus_playouts(tBenchCorpus *pCorpus, eRulesType RulesType, int Size, tRandom *pRandom);
+static void bench_corpus_trains(tBenchCorpus *pCorpus, const char *pName, bool Snake, int MinLength, int MaxLength,
+    int MinArea, int Size, tRandom *pRandom);
+static uint64_t bench_train(bool Snake, int Length, tRandom *pRandom);
+static int bench_largest_area(uint64_t Data);
+static int bench_run(tBenchCorpus *pCorpus);
+static int bench_compare(const void *pA, const void *pB);
+static double bench_time_ns(struct timespec *pBegin, struct timespec *pEnd);
+
+int main(int argc, char **argv)
+{
+    int Res = 0, Mismatches = 0, Boards = BENCH_DEFAULT_BOARDS, Trains;
+    tBenchCorpus Corpora[BENCH_CORPORA];
+    tRandom Random;
+
+    if (argc > 1 AND (Boards = atoi(argv[1])) <= 0)
+    {
+        fprintf(stderr, "Usage: %s [boards per corpus]\n", argv[0]);
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    Random.s[0] = BENCH_SEED_0;
+    Random.s[1] = BENCH_SEED_1;
+
+    scorer_init();
+
+    for (int i = 0; i < BENCH_RULES_TYPES; ++i)
+    {
+        bench_corpus_playouts(&Corpora[i], RULES_CLASSICAL + i, Boards, &Random);
+    }
+
+    Trains = IF (Boards > BENCH_TRAINS_DIVISOR) THEN Boards / BENCH_TRAINS_DIVISOR ELSE 1;
+
+    bench_corpus_trains(&Corpora[BENCH_RULES_TYPES], "snake", true, BENCH_TRAIN_LENGTH, BENCH_TRAIN_LENGTH, 0,
+        Trains, &Random);
+    bench_corpus_trains(&Corpora[BENCH_RULES_TYPES+1], "blob", false, BENCH_TRAIN_LENGTH, BENCH_TRAIN_LENGTH, 0,
+        Trains, &Random);
+    bench_corpus_trains(&Corpora[BENCH_RULES_TYPES+2], "short", true, BENCH_SHORT_MIN_LENGTH, BENCH_SHORT_MAX_LENGTH,
+        BENCH_SHORT_AREA, Trains, &Random);
+
+    printf("%-12s %-10s %10s %10s %10s %10s %10s %10s %10s\n", "corpus", "backend", "ns/board", "p50", "p90", "p99", "max",
+        "mismatch", "capped");
+
+    for (int i = 0; i < BENCH_CORPORA; ++i)
+    {
+        Mismatches += bench_run(&Corpora[i]);
+        free(Corpora[i].pBoards);
+    }
+
+    scorer_free();
+
+    if (Mismatches > 0)
+    {
+        fprintf(stderr, "[ERROR] Scoring backends disagree on %d boards\n", Mismatches);
+        Res = -EINVAL;
+    }
+
+Error:
+    return IF (Res < 0) THEN EXIT_FAILURE ELSE EXIT_SUCCESS;
+}
+
+static void bench_corpus_playouts(tBenchCorpus *pCorpus, eRulesType RulesType, int Size, tRandom *pRandom)
+{
+    tRules Rules;
+    tRulesConfig Config = { RulesType };
+
+    rules_init(&Rules, &Config);
+
+    snprintf(pCorpus->Name, sizeof(pCorpus->Name), "%s", BenchRulesNames[RulesType - RULES_CLASSICAL]);
+    pCorpus->pBoards = emalloc(Size * sizeof(tBoard));
+    pCorpus->Size = Size;
+    pCorpus->Adversarial = false;
+
+    for (int i = 0; i < Size; ++i)
+    {
+        board_init(&pCorpus->pBoards[i]);
+        rules_simulate_playout(&Rules, &pCorpus->pBoards[i], pRandom, i % 2 == 0);
+    }
+}
+
+/*
+ * Trains fill the board with large areas full of loops, on which the recursive
+ * backend is exponential, so it does not run on them. Trains are drawn again
+ * until the other player has an area of at least MinArea cells, so short snakes
+ * leave it one area of 40 cells or more.
+ */
+static void bench_corpus_trains(tBenchCorpus *pCorpus, const char *pName, bool Snake, int MinLength, int MaxLength,
+    int MinArea, int Size, tRandom *pRandom)
+{
+    snprintf(pCorpus->Name, sizeof(pCorpus->Name), "%s", pName);
+    pCorpus->pBoards = emalloc(Size * sizeof(tBoard));
+    pCorpus->Size = Size;
+    pCorpus->Adversarial = true;
+
+    for (int i = 0; i < Size; ++i)
+    {
+        tBoard *pBoard = &pCorpus->pBoards[i];
+
+        board_init(pBoard);
+
+        do
+        {
+            pBoard->Data = bench_train(Snake, MinLength + random_next(pRandom) % (MaxLength - MinLength + 1), pRandom);
+        }
+        while (bench_largest_area(~pBoard->Data & BOARD_MASK) < MinArea);
+
+        pBoard->Empty = 0ULL;
+    }
+}
+
+/*
+ * A snake is a self-avoiding walk that never touches itself, so it is one long
+ * train for X and leaves a large, loop-heavy area for O. A blob grows in any
+ * direction and is full of loops for both players.
+ */
+static uint64_t bench_train(bool Snake, int Length, tRandom *pRandom)
+{
+    uint64_t Train = 0ULL, Head = 0ULL;
+    tIndex Index = random_next(pRandom) % (ROWS*COLUMNS);
+
+    BitSet64(&Train, Index);
+    BitSet64(&Head, Index);
+
+    while (BitPopCount64(Train) < Length)
+    {
+        uint64_t Candidates = BOARD_EXPAND(IF Snake THEN Head ELSE Train) & ~Train;
+
+        if (Snake)
+        {
+            uint64_t Candidate = Candidates;
+
+            while (NOT BitEmpty64(Candidate))
+            {
+                tIndex Next = BitTzCount64(Candidate);
+
+                if (BitPopCount64(BOARD_EXPAND(1ULL << Next) & Train) > 1)
+                {
+                    BitReset64(&Candidates, Next);
+                }
+
+                BitReset64(&Candidate, Next);
+            }
+        }
+
+        if (BitEmpty64(Candidates))
+        {
+            break;
+        }
+
+        Index = BitScanRandom64(Candidates, pRandom);
+        Head = 1ULL << Index;
+
+        BitSet64(&Train, Index);
+    }
+
+    return Train;
+}
+
+static int bench_largest_area(uint64_t Data)
+{
+    int Largest = 0;
+
+    while (NOT BitEmpty64(Data))
+    {
+        uint64_t Area = pathfinder_area(Data, BitTzCount64(Data));
+        int Size = BitPopCount64(Area);
+
+        SET_IF_GREATER(Size, Largest);
+        Data &= ~Area;
+    }
+
+    return Largest;
+}
+
+/*
+ * The pathfinder backend counts the searches that reach the expansion cap, whose
+ * results may not be exact.
+ */
+static tSize bench_pathfinder(uint64_t Data, tIndex Index, uint64_t *pArea)
+{
+    bool Capped;
+    tSize PathLength = pathfinder_search(Data, Index, pArea, &Capped);
+
+    BenchCapped += Capped;
+
+    return PathLength;
+}
+
+static int bench_run(tBenchCorpus *pCorpus)
+{
+    int Mismatches = 0;
+    bool Reference = false;
+    tScore *pReference = emalloc(pCorpus->Size * sizeof(tScore));
+    tScore *pScores = emalloc(pCorpus->Size * sizeof(tScore));
+    double *pTimes = emalloc(pCorpus->Size * sizeof(double));
+
+    for (int b = 0; b < BENCH_BACKENDS; ++b)
+    {
+        const tBenchBackend *pBackend = &BenchBackends[b];
+        double Total = 0.0;
+        int BackendMismatches = 0, Step = IF pBackend->Batch THEN BENCH_BATCH_SIZE ELSE 1;
+
+        if (pCorpus->Adversarial AND NOT pBackend->Adversarial)
+        {
+            continue;
+        }
+
+        BenchCapped = 0;
+
+        for (int i = 0; i < pCorpus->Size; i += Step)
+        {
+            struct timespec Begin, End;
+            tBoard *pBoard = &pCorpus->pBoards[i];
+            int Count = IF (pBackend->Batch AND pCorpus->Size - i > BENCH_BATCH_SIZE) THEN BENCH_BATCH_SIZE
+                ELSE IF pBackend->Batch THEN pCorpus->Size - i
+                ELSE 1;
+
+            clock_gettime(CLOCK_MONOTONIC, &Begin);
+
+            if (pBackend->Batch)
+            {
+                board_score_batch(pBoard, Count, &pScores[i]);
+            }
+            else
+            {
+                pScores[i] = IF (pBackend->LongestPath ISNOT NULL) THEN board_score_with(pBoard, pBackend->LongestPath) ELSE board_score(pBoard);
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &End);
+
+            for (int j = i; j < i + Count; ++j)
+            {
+                pTimes[j] = bench_time_ns(&Begin, &End) / Count;
+                Total += pTimes[j];
+
+                if (NOT Reference)
+                {
+                    pReference[j] = pScores[j];
+                }
+                else if (pScores[j] != pReference[j])
+                {
+                    BackendMismatches++;
+                }
+            }
+        }
+
+        Reference = true;
+
+        qsort(pTimes, pCorpus->Size, sizeof(double), bench_compare);
+
+        printf("%-12s %-10s %10.0f %10.0f %10.0f %10.0f %10.0f %10d %10u\n", pCorpus->Name, pBackend->pName,
+            Total / pCorpus->Size,
+            pTimes[pCorpus->Size * 50 / 100],
+            pTimes[pCorpus->Size * 90 / 100],
+            pTimes[pCorpus->Size * 99 / 100],
+            pTimes[pCorpus->Size - 1],
+            BackendMismatches,
+            BenchCapped);
+
+        Mismatches += BackendMismatches;
+    }
+
+    free(pReference);
+    free(pScores);
+    free(pTimes);
+
+    return Mismatches;
+}
+
+static int bench_compare(const void *pA, const void *pB)
+{
+    double A = *(const double *) pA, B = *(const double *) pB;
+
+    return (A > B) - (A < B);
+}
+
+static double bench_time_ns(struct timespec *pBegin, struct timespec *pEnd)
+{
+    return (pEnd->tv_sec - pBegin->tv_sec) * 1.0e9 + (pEnd->tv_nsec - pBegin->tv_nsec);
+}
@@ -0,0 +1,336 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bitutil.h"
+#include "board.h"
+#include "book.h"
+#include "config.h"
+#include "engine.h"
+#include "rules.h"
+#include "types.h"
+#include "util.h"
+
+#define BOOK_DEFAULT_PLIES  2
+#define BOOK_MAX_PLIES      8
+#define BOOK_CENTER         24
+#define BOOK_REPORT         100
+
+typedef struct BookPosition
+{
+    uint8_t RulesType;
+    uint8_t Size;
+    uint8_t Moves[BOOK_MAX_PLIES];
+    uint64_t Entry;
+}
+tBookPosition;
+
+typedef struct BookBuild
+{
+    pthread_mutex_t Mutex;
+    tBookPosition *pPositions;
+    uint64_t Size;
+    uint64_t Capacity;
+    uint64_t Next;
+    uint64_t Done;
+    uint64_t Failures;
+    int Plies;
+    tEngineConfig Config;
+    tEngineBudget Budget;
+}
+tBookBuild;
+
+static void book_collect(tBookBuild *pBuild, tRules *pRules, tBookPosition *pPosition, tBoard *pBoard);
+static void *book_work(void *pArg);
+static int book_compare_positions(const void *pA, const void *pB);
+static void book_usage(const char *pName);
+
+/*
+ * Builds an opening book by searching every position reachable within the
+ * given number of plies, for every ruleset unless one is given. Positions in
+ * which the centre can still be taken are skipped, since the engine always
+ * takes it, and positions reached by different move orders are searched once.
+ * Each worker owns an engine that does not use a book.
+ */
+int main(int argc, char **argv)
+{
+    int Res = 0, Option, RulesType = 0;
+    long Workers = sysconf(_SC_NPROCESSORS_ONLN);
+    tBookBuild Build;
+    tConfig Config;
+    pthread_t *pWorkers;
+    uint64_t *pEntries, Unique = 0;
+
+    memset(&Build, 0, sizeof(Build));
+
+    Build.Plies = BOOK_DEFAULT_PLIES;
+
+    while ((Option = getopt(argc, argv, "d:s:t:j:r:")) ISNOT -1)
+    {
+        if (Option == 'd' AND atoi(optarg) > 0 AND atoi(optarg) <= BOOK_MAX_PLIES)
+        {
+            Build.Plies = atoi(optarg);
+        }
+        else if (Option == 's' AND atol(optarg) > 0)
+        {
+            Build.Budget.Simulations = atol(optarg);
+        }
+        else if (Option == 't' AND atol(optarg) > 0)
+        {
+            Build.Budget.TimeMs = atol(optarg);
+        }
+        else if (Option == 'j' AND atol(optarg) > 0)
+        {
+            Workers = atol(optarg);
+        }
+        else if (Option == 'r' AND atoi(optarg) >= RULES_CLASSICAL AND atoi(optarg) <= RULES_MALLORCAN)
+        {
+            RulesType = atoi(optarg);
+        }
+        else
+        {
+            book_usage(argv[0]);
+            Res = -EINVAL;
+            goto Error;
+        }
+    }
+
+    if (optind ISNOT argc - 1)
+    {
+        book_usage(argv[0]);
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    if (Build.Budget.TimeMs > 0 AND Build.Budget.Simulations == 0)
+    {
+        Build.Budget.Simulations = UINT32_MAX;
+    }
+
+    Res = config_init(&Config);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
+    Res = config_load(&Config);
+    if (Res < 0)
+    {
+        goto FreeConfig;
+    }
+
+    config_engine(&Config, &Build.Config);
+    Build.Config.pBookFile = NULL;
+
+    for (int r = RULES_CLASSICAL; r <= RULES_MALLORCAN; ++r)
+    {
+        tRulesConfig RulesConfig = { .RulesType = r };
+        tRules Rules;
+        tBookPosition Position;
+        tBoard Board;
+
+        if (RulesType ISNOT 0 AND r ISNOT RulesType)
+        {
+            continue;
+        }
+
+        rules_init(&Rules, &RulesConfig);
+        board_init(&Board);
+        memset(&Position, 0, sizeof(Position));
+        Position.RulesType = r;
+
+        book_collect(&Build, &Rules, &Position, &Board);
+    }
+
+    qsort(Build.pPositions, Build.Size, sizeof(tBookPosition), book_compare_positions);
+
+    for (uint64_t i = 0; i < Build.Size; ++i)
+    {
+        if (Unique == 0 OR Build.pPositions[i].Entry ISNOT Build.pPositions[Unique-1].Entry)
+        {
+            Build.pPositions[Unique++] = Build.pPositions[i];
+        }
+    }
+
+    Build.Size = Unique;
+
+    fprintf(stderr, "positions %lu\n", (unsigned long) Build.Size);
+
+    pthread_mutex_init(&Build.Mutex, NULL);
+    pWorkers = emalloc(Workers * sizeof(pthread_t));
+
+    for (long i = 0; i < Workers; ++i)
+    {
+        if (pthread_create(&pWorkers[i], NULL, book_work, &Build) ISNOT 0)
+        {
+            fprintf(stderr, "[ERROR] Cannot start worker thread\n");
+            Build.Failures++;
+            Workers = i;
+        }
+    }
+
+    for (long i = 0; i < Workers; ++i)
+    {
+        pthread_join(pWorkers[i], NULL);
+    }
+
+    free(pWorkers);
+    pthread_mutex_destroy(&Build.Mutex);
+
+    if (Build.Failures > 0)
+    {
+        fprintf(stderr, "[ERROR] %lu positions or workers failed\n", (unsigned long) Build.Failures);
+        Res = -EIO;
+        goto FreePositions;
+    }
+
+    pEntries = emalloc((Build.Size + 1) * sizeof(uint64_t));
+
+    for (uint64_t i = 0; i < Build.Size; ++i)
+    {
+        pEntries[i] = Build.pPositions[i].Entry;
+    }
+
+    Res = book_write(argv[optind], pEntries, Build.Size);
+    if (Res < 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot write file \"%s\"\n", argv[optind]);
+    }
+
+    free(pEntries);
+
+FreePositions:
+    free(Build.pPositions);
+
+FreeConfig:
+    config_free(&Config);
+
+Error:
+    return IF (Res < 0) THEN EXIT_FAILURE ELSE EXIT_SUCCESS;
+}
+
+/*
+ * Until the search, a position's entry holds the hash of its board alone, which
+ * is what identifies transpositions.
+ */
+static void book_collect(tBookBuild *pBuild, tRules *pRules, tBookPosition *pPosition, tBoard *pBoard)
+{
+    uint64_t Indices = rules_indices(pRules, pBoard, false);
+
+    if (board_finished(pBoard))
+    {
+        return;
+    }
+
+    if (NOT BitTest64(Indices, BOOK_CENTER))
+    {
+        if (pBuild->Size == pBuild->Capacity)
+        {
+            pBuild->Capacity = IF (pBuild->Capacity == 0) THEN 1024 ELSE 2 * pBuild->Capacity;
+            pBuild->pPositions = erealloc(pBuild->pPositions, pBuild->Capacity * sizeof(tBookPosition));
+        }
+
+        pPosition->Entry = book_entry(pPosition->RulesType, pBoard, 0);
+        pBuild->pPositions[pBuild->Size++] = *pPosition;
+    }
+
+    if (pPosition->Size == pBuild->Plies)
+    {
+        return;
+    }
+
+    while (NOT BitEmpty64(Indices))
+    {
+        tIndex Index = BitTzCount64(Indices);
+        tBoard Board;
+
+        BitReset64(&Indices, Index);
+
+        board_copy(&Board, pBoard);
+        board_advance(&Board, Index, rules_player(pRules, pBoard));
+
+        pPosition->Moves[pPosition->Size++] = Index;
+        book_collect(pBuild, pRules, pPosition, &Board);
+        pPosition->Size--;
+    }
+}
+
+static void *book_work(void *pArg)
+{
+    tBookBuild *pBuild = pArg;
+    tEngine *pEngine;
+
+    if (engine_create(&pEngine, &pBuild->Config) < 0)
+    {
+        pthread_mutex_lock(&pBuild->Mutex);
+        fprintf(stderr, "[ERROR] Cannot create engine\n");
+        pBuild->Failures++;
+        pthread_mutex_unlock(&pBuild->Mutex);
+        goto Error;
+    }
+
+    while (true)
+    {
+        tBookPosition *pPosition;
+        int Moves[BOOK_MAX_PLIES], Index = -EINVAL;
+
+        pthread_mutex_lock(&pBuild->Mutex);
+        pPosition = IF (pBuild->Next < pBuild->Size) THEN &pBuild->pPositions[pBuild->Next++] ELSE NULL;
+        pthread_mutex_unlock(&pBuild->Mutex);
+
+        if (pPosition IS NULL)
+        {
+            break;
+        }
+
+        for (int i = 0; i < pPosition->Size; ++i)
+        {
+            Moves[i] = pPosition->Moves[i];
+        }
+
+        if (engine_set_position(pEngine, pPosition->RulesType, Moves, pPosition->Size) == 0)
+        {
+            Index = engine_search(pEngine, &pBuild->Budget);
+        }
+
+        pthread_mutex_lock(&pBuild->Mutex);
+
+        if (Index >= 0)
+        {
+            pPosition->Entry |= Index;
+        }
+        else
+        {
+            pBuild->Failures++;
+        }
+
+        if (++pBuild->Done % BOOK_REPORT == 0)
+        {
+            fprintf(stderr, "positions %lu/%lu\n", (unsigned long) pBuild->Done, (unsigned long) pBuild->Size);
+        }
+
+        pthread_mutex_unlock(&pBuild->Mutex);
+    }
+
+    engine_free(pEngine);
+
+Error:
+    return NULL;
+}
+
+static int book_compare_positions(const void *pA, const void *pB)
+{
+    const tBookPosition *pPositionA = pA, *pPositionB = pB;
+
+    return (pPositionA->Entry > pPositionB->Entry) - (pPositionA->Entry < pPositionB->Entry);
+}
+
+static void book_usage(const char *pName)
+{
+    fprintf(stderr, "Usage: %s [-d plies] [-s simulations] [-t milliseconds] [-j workers] [-r rules] file\n", pName);
+}
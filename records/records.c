@@ -0,0 +1,231 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "board.h"
+#include "protocol.h"
+#include "record.h"
+#include "rules.h"
+#include "types.h"
+#include "util.h"
+
+static int records_pack(const char *pFile);
+static int records_unpack(const char *pFile);
+static int records_check(const char *pFile);
+static void records_usage(const char *pName);
+
+/*
+ * Converts games between text, one "<rules> <moves>" line per game as in the
+ * headless protocol, and binary records. "check" replays every record against
+ * its ruleset, checks the score of finished games and counts the results.
+ */
+int main(int argc, char **argv)
+{
+    int Res = 0;
+
+    if (argc ISNOT 3)
+    {
+        records_usage(argv[0]);
+        Res = -EINVAL;
+    }
+    else if (strcmp(argv[1], "pack") == 0)
+    {
+        Res = records_pack(argv[2]);
+    }
+    else if (strcmp(argv[1], "unpack") == 0)
+    {
+        Res = records_unpack(argv[2]);
+    }
+    else if (strcmp(argv[1], "check") == 0)
+    {
+        Res = records_check(argv[2]);
+    }
+    else
+    {
+        records_usage(argv[0]);
+        Res = -EINVAL;
+    }
+
+    return IF (Res < 0) THEN EXIT_FAILURE ELSE EXIT_SUCCESS;
+}
+
+static int records_pack(const char *pFile)
+{
+    int Res = 0;
+    uint64_t Line = 0, Invalid = 0;
+    char Buffer[PROTOCOL_MAXLINE];
+    tRecordWriter Writer;
+
+    Res = record_writer_open(&Writer, pFile);
+    if (Res < 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot open file \"%s\"\n", pFile);
+        goto Error;
+    }
+
+    while (Res == 0 AND fgets(Buffer, sizeof(Buffer), stdin) ISNOT NULL)
+    {
+        tProtocolRequest Request;
+        tRecord Record;
+        tBoard Board;
+        uint8_t Moves[ROWS*COLUMNS];
+
+        Line++;
+
+        if (Buffer[strspn(Buffer, " \t\r\n")] == '\0' OR Buffer[strspn(Buffer, " \t")] == '#')
+        {
+            continue;
+        }
+
+        memset(&Request, 0, sizeof(Request));
+
+        Record.RulesType = 0;
+        Record.Score = 0;
+        Record.Size = 0;
+        Record.pMoves = Moves;
+
+        if (protocol_parse_position(Buffer, &Request) == 0)
+        {
+            Record.RulesType = Request.RulesType;
+            Record.Size = Request.Size;
+
+            for (int i = 0; i < Request.Size; ++i)
+            {
+                Moves[i] = Request.Moves[i];
+            }
+        }
+
+        if (record_replay(&Record, &Board) < 0)
+        {
+            fprintf(stderr, "[ERROR] Invalid game at line %lu\n", (unsigned long) Line);
+            Invalid++;
+            continue;
+        }
+
+        Res = record_write(&Writer, Record.RulesType, Request.Moves, Request.Size,
+            IF board_finished(&Board) THEN board_score(&Board) ELSE 0, NULL);
+    }
+
+    if (record_writer_close(&Writer) < 0 OR Res < 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot write file \"%s\"\n", pFile);
+        Res = -EIO;
+    }
+    else if (Invalid > 0)
+    {
+        Res = -EINVAL;
+    }
+
+Error:
+    return Res;
+}
+
+static int records_unpack(const char *pFile)
+{
+    int Res;
+    tRecordReader Reader;
+    tRecord Record;
+
+    Res = record_reader_open(&Reader, pFile);
+    if (Res < 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot read file \"%s\"\n", pFile);
+        goto Error;
+    }
+
+    while ((Res = record_next(&Reader, &Record)) == 0)
+    {
+        printf("%d", Record.RulesType);
+
+        for (tSize i = 0; i < Record.Size; ++i)
+        {
+            char Id[BOARD_ID_STR_LEN];
+
+            board_index_id_to_buf(Record.pMoves[i], Id, sizeof(Id));
+            printf(" %s", Id);
+        }
+
+        printf("\n");
+    }
+
+    record_reader_close(&Reader);
+
+    if (Res == -ENODATA)
+    {
+        Res = 0;
+    }
+    else
+    {
+        fprintf(stderr, "[ERROR] Truncated file \"%s\"\n", pFile);
+    }
+
+Error:
+    return Res;
+}
+
+static int records_check(const char *pFile)
+{
+    int Res;
+    uint64_t Games = 0, Finished = 0, WinsX = 0, WinsO = 0, Invalid = 0;
+    tRecordReader Reader;
+    tRecord Record;
+    struct timespec Begin, End;
+    double Seconds;
+
+    clock_gettime(CLOCK_MONOTONIC, &Begin);
+
+    Res = record_reader_open(&Reader, pFile);
+    if (Res < 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot read file \"%s\"\n", pFile);
+        goto Error;
+    }
+
+    while ((Res = record_next(&Reader, &Record)) == 0)
+    {
+        tBoard Board;
+
+        Games++;
+
+        if (record_replay(&Record, &Board) < 0 OR (board_finished(&Board) AND board_score(&Board) ISNOT Record.Score))
+        {
+            Invalid++;
+        }
+        else if (board_finished(&Board))
+        {
+            Finished++;
+            WinsX += Record.Score > 0;
+            WinsO += Record.Score < 0;
+        }
+    }
+
+    record_reader_close(&Reader);
+
+    clock_gettime(CLOCK_MONOTONIC, &End);
+    Seconds = (End.tv_sec - Begin.tv_sec) + (End.tv_nsec - Begin.tv_nsec) / 1.0e9;
+
+    printf("games %lu finished %lu x %lu o %lu draws %lu invalid %lu time %.3f s\n", (unsigned long) Games,
+        (unsigned long) Finished, (unsigned long) WinsX, (unsigned long) WinsO, (unsigned long) (Finished - WinsX - WinsO),
+        (unsigned long) Invalid, Seconds);
+
+    if (Res ISNOT -ENODATA)
+    {
+        fprintf(stderr, "[ERROR] Truncated file \"%s\"\n", pFile);
+    }
+    else
+    {
+        Res = IF (Invalid > 0) THEN -EINVAL ELSE 0;
+    }
+
+Error:
+    return Res;
+}
+
+static void records_usage(const char *pName)
+{
+    fprintf(stderr, "Usage: %s pack|unpack|check file\n", pName);
+}
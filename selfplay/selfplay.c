@@ -0,0 +1,381 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "config.h"
+#include "engine.h"
+#include "random.h"
+#include "record.h"
+#include "rules.h"
+#include "util.h"
+
+#define SELFPLAY_DEFAULT_GAMES  1000
+#define SELFPLAY_RULES_TYPES    (RULES_MALLORCAN - RULES_CLASSICAL + 1)
+#define SELFPLAY_SEED           0x9E3779B97F4A7C15ULL
+#define SELFPLAY_REPORT_GAMES   1000
+
+typedef struct SelfPlay
+{
+    tRecordWriter Writer;
+    pthread_mutex_t Mutex;
+    uint64_t Games;
+    uint64_t Started;
+    uint64_t Finished;
+    uint64_t Moves;
+    uint64_t Failures;
+    int RulesType;
+    uint32_t SamplePlies;
+    tEngineConfig Config;
+    tEngineBudget Budget;
+    tRandom Random;
+}
+tSelfPlay;
+
+typedef struct SelfPlayWorker
+{
+    tSelfPlay *pSelfPlay;
+    tRandom Random;
+    tScore Score;
+    int Size;
+    int Moves[ROWS*COLUMNS];
+    tRecordSearch Searches[ROWS*COLUMNS];
+}
+tSelfPlayWorker;
+
+static volatile sig_atomic_t SelfPlaySignaled = 0;
+
+static void *selfplay_work(void *pArg);
+static int selfplay_game(tSelfPlayWorker *pWorker, tEngine *pEngine, int RulesType);
+static int selfplay_sample(tSelfPlayWorker *pWorker, const tEngineChild *pChildren, int Size);
+static void selfplay_usage(const char *pName);
+static void selfplay_signal(int Signal);
+
+/*
+ * Plays engine against engine on every processor and appends each finished game
+ * to the output as a game record, with the visits of the root moves searched
+ * before every move. Moves played without a search, by the opening rule or the
+ * endgame solver, have no root moves. Games cycle through the rulesets unless one is given, and
+ * the first plies may be sampled in proportion to the visits to vary the games.
+ * On SIGINT or SIGTERM the games in progress are dropped, so the output only
+ * ever holds complete records.
+ */
+int main(int argc, char **argv)
+{
+    int Res = 0, Option;
+    long Workers = sysconf(_SC_NPROCESSORS_ONLN);
+    tSelfPlay SelfPlay;
+    tSelfPlayWorker *pWorkers;
+    pthread_t *pThreads;
+    tConfig Config;
+    struct sigaction Action;
+    struct timespec Begin, End;
+    double Seconds;
+
+    memset(&SelfPlay, 0, sizeof(SelfPlay));
+
+    SelfPlay.Games = SELFPLAY_DEFAULT_GAMES;
+
+    while ((Option = getopt(argc, argv, "g:s:t:j:r:p:")) ISNOT -1)
+    {
+        if (Option == 'g' AND atol(optarg) > 0)
+        {
+            SelfPlay.Games = strtoull(optarg, NULL, 10);
+        }
+        else if (Option == 's' AND atol(optarg) > 0)
+        {
+            SelfPlay.Budget.Simulations = atol(optarg);
+        }
+        else if (Option == 't' AND atol(optarg) > 0)
+        {
+            SelfPlay.Budget.TimeMs = atol(optarg);
+        }
+        else if (Option == 'j' AND atol(optarg) > 0)
+        {
+            Workers = atol(optarg);
+        }
+        else if (Option == 'r' AND atoi(optarg) >= RULES_CLASSICAL AND atoi(optarg) <= RULES_MALLORCAN)
+        {
+            SelfPlay.RulesType = atoi(optarg);
+        }
+        else if (Option == 'p' AND atol(optarg) >= 0)
+        {
+            SelfPlay.SamplePlies = atol(optarg);
+        }
+        else
+        {
+            selfplay_usage(argv[0]);
+            Res = -EINVAL;
+            goto Error;
+        }
+    }
+
+    if (optind ISNOT argc - 1)
+    {
+        selfplay_usage(argv[0]);
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    if (SelfPlay.Budget.TimeMs > 0 AND SelfPlay.Budget.Simulations == 0)
+    {
+        SelfPlay.Budget.Simulations = UINT32_MAX;
+    }
+
+    Res = record_writer_open(&SelfPlay.Writer, argv[optind]);
+    if (Res < 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot open file \"%s\"\n", argv[optind]);
+        goto Error;
+    }
+
+    Res = config_init(&Config);
+    if (Res < 0)
+    {
+        goto CloseOut;
+    }
+
+    Res = config_load(&Config);
+    if (Res < 0)
+    {
+        goto FreeConfig;
+    }
+
+    config_engine(&Config, &SelfPlay.Config);
+
+    memset(&Action, 0, sizeof(Action));
+    Action.sa_handler = selfplay_signal;
+    sigaction(SIGINT, &Action, NULL);
+    sigaction(SIGTERM, &Action, NULL);
+
+    pthread_mutex_init(&SelfPlay.Mutex, NULL);
+    random_init(&SelfPlay.Random);
+
+    pWorkers = emalloc(Workers * sizeof(tSelfPlayWorker));
+    pThreads = emalloc(Workers * sizeof(pthread_t));
+
+    clock_gettime(CLOCK_MONOTONIC, &Begin);
+
+    for (long i = 0; i < Workers; ++i)
+    {
+        pWorkers[i].pSelfPlay = &SelfPlay;
+        pWorkers[i].Random = SelfPlay.Random;
+        pWorkers[i].Random.s[0] ^= (i + 1) * SELFPLAY_SEED;
+
+        if (pthread_create(&pThreads[i], NULL, selfplay_work, &pWorkers[i]) ISNOT 0)
+        {
+            fprintf(stderr, "[ERROR] Cannot start worker thread\n");
+            SelfPlay.Failures++;
+            Workers = i;
+        }
+    }
+
+    for (long i = 0; i < Workers; ++i)
+    {
+        pthread_join(pThreads[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &End);
+    Seconds = (End.tv_sec - Begin.tv_sec) + (End.tv_nsec - Begin.tv_nsec) / 1.0e9;
+
+    fprintf(stderr, "games %lu moves %lu time %.1f s games/s %.2f\n", (unsigned long) SelfPlay.Finished,
+        (unsigned long) SelfPlay.Moves, Seconds, SelfPlay.Finished / Seconds);
+
+    free(pThreads);
+    free(pWorkers);
+    pthread_mutex_destroy(&SelfPlay.Mutex);
+
+    if (SelfPlay.Failures > 0)
+    {
+        fprintf(stderr, "[ERROR] %lu games or workers failed\n", (unsigned long) SelfPlay.Failures);
+        Res = -EIO;
+    }
+
+FreeConfig:
+    config_free(&Config);
+
+CloseOut:
+    if (record_writer_close(&SelfPlay.Writer) < 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot write file \"%s\"\n", argv[optind]);
+        Res = -EIO;
+    }
+
+Error:
+    return IF (Res < 0) THEN EXIT_FAILURE ELSE EXIT_SUCCESS;
+}
+
+static void *selfplay_work(void *pArg)
+{
+    tSelfPlayWorker *pWorker = pArg;
+    tSelfPlay *pSelfPlay = pWorker->pSelfPlay;
+    tEngine *pEngine;
+
+    if (engine_create(&pEngine, &pSelfPlay->Config) < 0)
+    {
+        pthread_mutex_lock(&pSelfPlay->Mutex);
+        fprintf(stderr, "[ERROR] Cannot create engine\n");
+        pSelfPlay->Failures++;
+        pthread_mutex_unlock(&pSelfPlay->Mutex);
+        goto Error;
+    }
+
+    while (NOT SelfPlaySignaled)
+    {
+        int RulesType = pSelfPlay->RulesType, Res;
+        uint64_t Game;
+
+        pthread_mutex_lock(&pSelfPlay->Mutex);
+        Game = pSelfPlay->Started++;
+        pthread_mutex_unlock(&pSelfPlay->Mutex);
+
+        if (Game >= pSelfPlay->Games)
+        {
+            break;
+        }
+
+        if (RulesType == 0)
+        {
+            RulesType = RULES_CLASSICAL + Game % SELFPLAY_RULES_TYPES;
+        }
+
+        Res = selfplay_game(pWorker, pEngine, RulesType);
+
+        pthread_mutex_lock(&pSelfPlay->Mutex);
+
+        if (Res == 0)
+        {
+            Res = record_write(&pSelfPlay->Writer, RulesType, pWorker->Moves, pWorker->Size, pWorker->Score,
+                pWorker->Searches);
+        }
+
+        if (Res == 0)
+        {
+            pSelfPlay->Finished++;
+            pSelfPlay->Moves += pWorker->Size;
+
+            if (pSelfPlay->Finished % SELFPLAY_REPORT_GAMES == 0)
+            {
+                fprintf(stderr, "games %lu\n", (unsigned long) pSelfPlay->Finished);
+            }
+        }
+        else if (Res ISNOT -EINTR)
+        {
+            pSelfPlay->Failures++;
+        }
+
+        pthread_mutex_unlock(&pSelfPlay->Mutex);
+    }
+
+    engine_free(pEngine);
+
+Error:
+    return NULL;
+}
+
+static int selfplay_game(tSelfPlayWorker *pWorker, tEngine *pEngine, int RulesType)
+{
+    int Res;
+    tEngineChild Children[ROWS*COLUMNS];
+
+    Res = engine_set_position(pEngine, RulesType, NULL, 0);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
+    pWorker->Size = 0;
+
+    while (NOT engine_finished(pEngine))
+    {
+        tRecordSearch *pSearch = &pWorker->Searches[pWorker->Size];
+        int Index, Size;
+
+        if (SelfPlaySignaled)
+        {
+            Res = -EINTR;
+            goto Error;
+        }
+
+        Index = engine_search(pEngine, &pWorker->pSelfPlay->Budget);
+        if (Index < 0)
+        {
+            Res = Index;
+            goto Error;
+        }
+
+        Size = engine_children(pEngine, Children, ROWS*COLUMNS);
+
+        if (Size > 0 AND (uint32_t) pWorker->Size < pWorker->pSelfPlay->SamplePlies)
+        {
+            Index = selfplay_sample(pWorker, Children, Size);
+        }
+
+        pSearch->Size = Size;
+
+        for (int i = 0; i < Size; ++i)
+        {
+            pSearch->Indices[i] = Children[i].Index;
+            pSearch->Visits[i] = Children[i].Visits;
+        }
+
+        Res = engine_give_move(pEngine, Index);
+        if (Res < 0)
+        {
+            goto Error;
+        }
+
+        pWorker->Moves[pWorker->Size++] = Index;
+    }
+
+    pWorker->Score = engine_score(pEngine);
+
+Error:
+    return Res;
+}
+
+/*
+ * Picks a move in proportion to its visits, or the first move if none has any.
+ */
+static int selfplay_sample(tSelfPlayWorker *pWorker, const tEngineChild *pChildren, int Size)
+{
+    uint64_t Total = 0, Pick;
+    int i, Index = pChildren[0].Index;
+
+    for (i = 0; i < Size; ++i)
+    {
+        Total += pChildren[i].Visits;
+    }
+
+    if (Total > 0)
+    {
+        Pick = random_next(&pWorker->Random) % Total;
+
+        for (i = 0; i < Size - 1 AND Pick >= pChildren[i].Visits; ++i)
+        {
+            Pick -= pChildren[i].Visits;
+        }
+
+        Index = pChildren[i].Index;
+    }
+
+    return Index;
+}
+
+static void selfplay_usage(const char *pName)
+{
+    fprintf(stderr, "Usage: %s [-g games] [-s simulations] [-t milliseconds] [-j workers] [-r rules] "
+        "[-p sampled plies] file\n", pName);
+}
+
+static void selfplay_signal(int Signal)
+{
+    SelfPlaySignaled = Signal;
+}
@@ -0,0 +1,732 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "engine.h"
+#include "protocol.h"
+#include "util.h"
+
+#define SERVER_DEFAULT_PATH     "tictactrains.sock"
+#define SERVER_MAX_GAMES        1024
+#define SERVER_BACKLOG          64
+#define SERVER_POLLS            (SERVER_MAX_GAMES + 2)
+#define SERVER_OUTPUT_LEN       16384
+#define SERVER_WAKES            64
+#define SERVER_WAKE_OUTPUT      (1U << 31)
+
+typedef struct Server tServer;
+
+typedef struct ServerGame
+{
+    int Fd;
+    uint32_t Slot;
+    tServer *pServer;
+    tEngine *pEngine;
+    char Buffer[PROTOCOL_MAXLINE];
+    size_t Length;
+    char Output[SERVER_OUTPUT_LEN];
+    size_t OutLength;
+    bool Woken;
+    bool Stalled;
+    bool Busy;
+    bool Closing;
+    atomic_bool Stop;
+    tProtocolRequest Request;
+    pthread_mutex_t Mutex;
+    struct ServerGame *pNext;
+}
+tServerGame;
+
+struct Server
+{
+    int Listener;
+    int Wake[2];
+    tServerGame *pGames[SERVER_MAX_GAMES];
+    pthread_t *pWorkers;
+    long Workers;
+    pthread_mutex_t Mutex;
+    pthread_cond_t Cond;
+    tServerGame *pHead;
+    tServerGame *pTail;
+    bool Quit;
+    tEngineConfig Config;
+};
+
+static volatile sig_atomic_t ServerSignaled = 0;
+
+static int server_listen(tServer *pServer, const char *pPath);
+static void server_accept(tServer *pServer);
+static void server_read(tServer *pServer, tServerGame *pGame);
+static void server_wake(tServer *pServer);
+static void server_process(tServer *pServer, tServerGame *pGame);
+static size_t server_peek_line(tServerGame *pGame, char *pLine);
+static void server_drop_line(tServerGame *pGame, size_t Size);
+static void server_push(tServer *pServer, tServerGame *pGame, tProtocolRequest *pRequest);
+static void *server_work(void *pArg);
+static void server_close(tServer *pServer, tServerGame *pGame);
+static void server_free_game(tServer *pServer, tServerGame *pGame);
+static short server_events(tServer *pServer, tServerGame *pGame);
+static void server_print(void *pContext, const char *pLine);
+static void server_flush(tServerGame *pGame);
+static void server_signal(int Signal);
+
+/*
+ * Hosts many games in one process. Each connection to the Unix socket is a game
+ * with its own engine and speaks the headless protocol. The main thread only
+ * reads and parses commands; positions and searches are queued for a fixed pool
+ * of workers, so a game runs at most one job at a time and "stop" and "isready"
+ * are still answered while it searches. All engines share the scorer table.
+ * Sockets are non-blocking and replies are buffered per game, so a client that
+ * stops reading is closed once its buffer is full instead of stalling a thread.
+ */
+int main(int argc, char **argv)
+{
+    int Res = 0;
+    tServer Server;
+    tConfig Config;
+    struct pollfd Polls[SERVER_POLLS];
+    tServerGame *pPolled[SERVER_POLLS];
+    struct sigaction Action;
+    const char *pPath = IF (argc > 1) THEN argv[1] ELSE SERVER_DEFAULT_PATH;
+
+    memset(&Server, 0, sizeof(Server));
+
+    Server.Workers = IF (argc > 2) THEN atol(argv[2]) ELSE sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (Server.Workers <= 0)
+    {
+        fprintf(stderr, "Usage: %s [socket path] [workers]\n", argv[0]);
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    Res = config_init(&Config);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
+    Res = config_load(&Config);
+    if (Res < 0)
+    {
+        goto FreeConfig;
+    }
+
+    config_engine(&Config, &Server.Config);
+
+    memset(&Action, 0, sizeof(Action));
+    Action.sa_handler = server_signal;
+    sigaction(SIGINT, &Action, NULL);
+    sigaction(SIGTERM, &Action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Res = server_listen(&Server, pPath);
+    if (Res < 0)
+    {
+        goto FreeConfig;
+    }
+
+    pthread_mutex_init(&Server.Mutex, NULL);
+    pthread_cond_init(&Server.Cond, NULL);
+
+    Server.pWorkers = emalloc(Server.Workers * sizeof(pthread_t));
+
+    for (long i = 0; i < Server.Workers; ++i)
+    {
+        if (pthread_create(&Server.pWorkers[i], NULL, server_work, &Server) ISNOT 0)
+        {
+            fprintf(stderr, "[ERROR] Cannot start worker thread\n");
+            Server.Workers = i;
+        }
+    }
+
+    if (Server.Workers == 0)
+    {
+        Res = -EAGAIN;
+    }
+    else
+    {
+        printf("Listening on %s with %ld workers\n", pPath, Server.Workers);
+        fflush(stdout);
+    }
+
+    while (Res == 0 AND NOT ServerSignaled)
+    {
+        nfds_t Count = 2;
+
+        Polls[0].fd = Server.Listener;
+        Polls[0].events = POLLIN;
+        Polls[1].fd = Server.Wake[0];
+        Polls[1].events = POLLIN;
+
+        for (uint32_t i = 0; i < SERVER_MAX_GAMES; ++i)
+        {
+            short Events = IF (Server.pGames[i] ISNOT NULL) THEN server_events(&Server, Server.pGames[i]) ELSE 0;
+
+            if (Events ISNOT 0)
+            {
+                Polls[Count].fd = Server.pGames[i]->Fd;
+                Polls[Count].events = Events;
+                pPolled[Count++] = Server.pGames[i];
+            }
+        }
+
+        if (poll(Polls, Count, -1) < 0)
+        {
+            continue;
+        }
+
+        /*
+         * Wake-ups are handled after the reads, as they may free a game that is
+         * still in pPolled for this pass.
+         */
+
+        for (nfds_t i = 2; i < Count; ++i)
+        {
+            if (Polls[i].revents & POLLOUT)
+            {
+                pthread_mutex_lock(&pPolled[i]->Mutex);
+                server_flush(pPolled[i]);
+                pthread_mutex_unlock(&pPolled[i]->Mutex);
+            }
+
+            if (Polls[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                server_read(&Server, pPolled[i]);
+            }
+        }
+
+        if (Polls[1].revents & POLLIN)
+        {
+            server_wake(&Server);
+        }
+
+        if (Polls[0].revents & POLLIN)
+        {
+            server_accept(&Server);
+        }
+    }
+
+    pthread_mutex_lock(&Server.Mutex);
+    Server.Quit = true;
+    pthread_cond_broadcast(&Server.Cond);
+    pthread_mutex_unlock(&Server.Mutex);
+
+    for (uint32_t i = 0; i < SERVER_MAX_GAMES; ++i)
+    {
+        if (Server.pGames[i] ISNOT NULL)
+        {
+            atomic_store(&Server.pGames[i]->Stop, true);
+            engine_stop(Server.pGames[i]->pEngine);
+        }
+    }
+
+    for (long i = 0; i < Server.Workers; ++i)
+    {
+        pthread_join(Server.pWorkers[i], NULL);
+    }
+
+    for (uint32_t i = 0; i < SERVER_MAX_GAMES; ++i)
+    {
+        if (Server.pGames[i] ISNOT NULL)
+        {
+            server_free_game(&Server, Server.pGames[i]);
+        }
+    }
+
+    free(Server.pWorkers);
+    pthread_cond_destroy(&Server.Cond);
+    pthread_mutex_destroy(&Server.Mutex);
+
+    close(Server.Wake[0]);
+    close(Server.Wake[1]);
+    close(Server.Listener);
+    unlink(pPath);
+
+FreeConfig:
+    config_free(&Config);
+
+Error:
+    return IF (Res < 0) THEN EXIT_FAILURE ELSE EXIT_SUCCESS;
+}
+
+static int server_listen(tServer *pServer, const char *pPath)
+{
+    int Res = 0;
+    struct sockaddr_un Address;
+
+    if (strlen(pPath) >= sizeof(Address.sun_path))
+    {
+        Res = -ENAMETOOLONG;
+        fprintf(stderr, "[ERROR] Socket path \"%s\" is too long\n", pPath);
+        goto Error;
+    }
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_UNIX;
+    strcpy(Address.sun_path, pPath);
+
+    pServer->Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (pServer->Listener < 0)
+    {
+        Res = -errno;
+        goto Error;
+    }
+
+    unlink(pPath);
+
+    if (bind(pServer->Listener, (struct sockaddr *) &Address, sizeof(Address)) < 0
+        OR listen(pServer->Listener, SERVER_BACKLOG) < 0)
+    {
+        Res = -errno;
+        fprintf(stderr, "[ERROR] Cannot listen on \"%s\"\n", pPath);
+        goto CloseListener;
+    }
+
+    if (pipe(pServer->Wake) < 0)
+    {
+        Res = -errno;
+        goto CloseListener;
+    }
+
+    fcntl(pServer->Wake[0], F_SETFL, fcntl(pServer->Wake[0], F_GETFL) | O_NONBLOCK);
+
+    goto Success;
+
+CloseListener:
+    close(pServer->Listener);
+
+Error:
+Success:
+    return Res;
+}
+
+static void server_accept(tServer *pServer)
+{
+    int Fd = accept(pServer->Listener, NULL, NULL);
+    uint32_t Slot = 0;
+    tServerGame *pGame;
+
+    if (Fd < 0)
+    {
+        goto Error;
+    }
+
+    if (fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        goto CloseFd;
+    }
+
+    while (Slot < SERVER_MAX_GAMES AND pServer->pGames[Slot] ISNOT NULL)
+    {
+        Slot++;
+    }
+
+    if (Slot == SERVER_MAX_GAMES)
+    {
+        goto CloseFd;
+    }
+
+    pGame = emalloc(sizeof(tServerGame));
+
+    if (engine_create(&pGame->pEngine, &pServer->Config) < 0)
+    {
+        free(pGame);
+        goto CloseFd;
+    }
+
+    pGame->Fd = Fd;
+    pGame->Slot = Slot;
+    pGame->pServer = pServer;
+    pGame->Length = 0;
+    pGame->OutLength = 0;
+    pGame->Woken = false;
+    pGame->Stalled = false;
+    pGame->Busy = false;
+    pGame->Closing = false;
+    pGame->pNext = NULL;
+
+    atomic_init(&pGame->Stop, false);
+    pthread_mutex_init(&pGame->Mutex, NULL);
+
+    pServer->pGames[Slot] = pGame;
+
+    goto Success;
+
+CloseFd:
+    close(Fd);
+
+Error:
+Success:
+    return;
+}
+
+static void server_read(tServer *pServer, tServerGame *pGame)
+{
+    ssize_t Size = read(pGame->Fd, pGame->Buffer + pGame->Length, sizeof(pGame->Buffer) - pGame->Length);
+
+    if (Size < 0 AND (errno == EAGAIN OR errno == EINTR))
+    {
+        return;
+    }
+
+    if (Size <= 0)
+    {
+        server_close(pServer, pGame);
+    }
+    else
+    {
+        pGame->Length += Size;
+
+        server_process(pServer, pGame);
+
+        if (pGame->Length == sizeof(pGame->Buffer) AND memchr(pGame->Buffer, '\n', pGame->Length) IS NULL)
+        {
+            server_print(pGame, "error line too long");
+            server_close(pServer, pGame);
+        }
+    }
+}
+
+/*
+ * Workers write the slot of a game when its job is done, or with
+ * SERVER_WAKE_OUTPUT set when it has replies to send, which only needs the poll
+ * set to be rebuilt. The pipe is drained on every pass, and a game adds at most
+ * one of each per pass, so it cannot fill up and block a writer.
+ */
+static void server_wake(tServer *pServer)
+{
+    uint32_t Slots[SERVER_WAKES];
+    ssize_t Size;
+
+    while ((Size = read(pServer->Wake[0], Slots, sizeof(Slots))) > 0)
+    {
+        for (ssize_t i = 0; i < Size / (ssize_t) sizeof(uint32_t); ++i)
+        {
+            tServerGame *pGame;
+
+            if (Slots[i] & SERVER_WAKE_OUTPUT)
+            {
+                continue;
+            }
+
+            pGame = pServer->pGames[Slots[i]];
+            pGame->Busy = false;
+
+            if (pGame->Closing)
+            {
+                server_free_game(pServer, pGame);
+            }
+            else
+            {
+                server_process(pServer, pGame);
+            }
+        }
+    }
+}
+
+/*
+ * Handles the buffered commands in order. While the game is busy, only "stop",
+ * "isready", and "quit" are taken, and later commands wait for the job.
+ */
+static void server_process(tServer *pServer, tServerGame *pGame)
+{
+    char Line[PROTOCOL_MAXLINE];
+    size_t Size;
+
+    while (NOT pGame->Closing AND (Size = server_peek_line(pGame, Line)) > 0)
+    {
+        tProtocolRequest Request;
+        int Res = protocol_parse(Line, &Request);
+
+        if (pGame->Busy AND Request.Command ISNOT PROTOCOL_STOP AND Request.Command ISNOT PROTOCOL_ISREADY
+            AND Request.Command ISNOT PROTOCOL_QUIT AND Request.Command ISNOT PROTOCOL_NONE)
+        {
+            break;
+        }
+
+        server_drop_line(pGame, Size);
+
+        if (Request.Command IS PROTOCOL_QUIT)
+        {
+            server_close(pServer, pGame);
+        }
+        else if (Request.Command IS PROTOCOL_STOP)
+        {
+            atomic_store(&pGame->Stop, true);
+            engine_stop(pGame->pEngine);
+        }
+        else if (Request.Command IS PROTOCOL_ISREADY)
+        {
+            server_print(pGame, "readyok");
+        }
+        else if (Request.Command IS PROTOCOL_UNKNOWN)
+        {
+            server_print(pGame, "error unknown command");
+        }
+        else if (Request.Command ISNOT PROTOCOL_NONE AND (Res < 0
+            OR (Request.Command IS PROTOCOL_GO AND engine_finished(pGame->pEngine))))
+        {
+            server_print(pGame, IF (Request.Command IS PROTOCOL_GO) THEN "error invalid go" ELSE "error invalid position");
+        }
+        else if (Request.Command ISNOT PROTOCOL_NONE)
+        {
+            server_push(pServer, pGame, &Request);
+        }
+    }
+}
+
+/*
+ * Copies the first complete line out of the buffer and returns its size with
+ * the newline, or 0 if there is no complete line yet.
+ */
+static size_t server_peek_line(tServerGame *pGame, char *pLine)
+{
+    char *pEnd = memchr(pGame->Buffer, '\n', pGame->Length);
+    size_t Size = 0;
+
+    if (pEnd ISNOT NULL)
+    {
+        Size = pEnd - pGame->Buffer + 1;
+
+        memcpy(pLine, pGame->Buffer, Size);
+        pLine[Size - 1] = '\0';
+    }
+
+    return Size;
+}
+
+static void server_drop_line(tServerGame *pGame, size_t Size)
+{
+    memmove(pGame->Buffer, pGame->Buffer + Size, pGame->Length - Size);
+    pGame->Length -= Size;
+}
+
+static void server_push(tServer *pServer, tServerGame *pGame, tProtocolRequest *pRequest)
+{
+    pGame->Request = *pRequest;
+    pGame->Request.pName = NULL;
+    pGame->Busy = true;
+    pGame->pNext = NULL;
+
+    atomic_store(&pGame->Stop, false);
+    engine_clear_stop(pGame->pEngine);
+
+    pthread_mutex_lock(&pServer->Mutex);
+
+    if (pServer->pTail IS NULL)
+    {
+        pServer->pHead = pGame;
+    }
+    else
+    {
+        pServer->pTail->pNext = pGame;
+    }
+
+    pServer->pTail = pGame;
+
+    pthread_cond_signal(&pServer->Cond);
+    pthread_mutex_unlock(&pServer->Mutex);
+}
+
+static void *server_work(void *pArg)
+{
+    tServer *pServer = pArg;
+
+    while (true)
+    {
+        tServerGame *pGame;
+        uint32_t Slot;
+
+        pthread_mutex_lock(&pServer->Mutex);
+
+        while (pServer->pHead IS NULL AND NOT pServer->Quit)
+        {
+            pthread_cond_wait(&pServer->Cond, &pServer->Mutex);
+        }
+
+        if (pServer->pHead IS NULL)
+        {
+            pthread_mutex_unlock(&pServer->Mutex);
+            break;
+        }
+
+        pGame = pServer->pHead;
+        pServer->pHead = pGame->pNext;
+
+        if (pServer->pHead IS NULL)
+        {
+            pServer->pTail = NULL;
+        }
+
+        pthread_mutex_unlock(&pServer->Mutex);
+
+        if (pGame->Request.Command IS PROTOCOL_POSITION)
+        {
+            if (protocol_position(pGame->pEngine, &pGame->Request) < 0)
+            {
+                server_print(pGame, "error invalid position");
+            }
+        }
+        else
+        {
+            protocol_search(pGame->pEngine, &pGame->Request, pServer->Config.Simulations, &pGame->Stop, server_print, pGame);
+        }
+
+        /*
+         * The main thread may free the game as soon as the wake-up lands.
+         */
+        Slot = pGame->Slot;
+
+        if (write(pServer->Wake[1], &Slot, sizeof(Slot)) ISNOT sizeof(Slot))
+        {
+            fprintf(stderr, "[ERROR] Cannot wake the main thread\n");
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * A game that hangs up while it searches is stopped, and is only freed once
+ * its worker is done with it.
+ */
+static void server_close(tServer *pServer, tServerGame *pGame)
+{
+    pGame->Closing = true;
+
+    if (pGame->Busy)
+    {
+        atomic_store(&pGame->Stop, true);
+        engine_stop(pGame->pEngine);
+    }
+    else
+    {
+        server_free_game(pServer, pGame);
+    }
+}
+
+static void server_free_game(tServer *pServer, tServerGame *pGame)
+{
+    pServer->pGames[pGame->Slot] = NULL;
+
+    close(pGame->Fd);
+    engine_free(pGame->pEngine);
+    pthread_mutex_destroy(&pGame->Mutex);
+    free(pGame);
+}
+
+/*
+ * Returns what to poll the game for, or 0 to leave it out of this pass. A game
+ * whose client stopped reading is closed here, where no other pass can still
+ * refer to it.
+ */
+static short server_events(tServer *pServer, tServerGame *pGame)
+{
+    short Events = 0;
+    bool Stalled;
+
+    pthread_mutex_lock(&pGame->Mutex);
+
+    Stalled = pGame->Stalled;
+    pGame->Woken = false;
+
+    if (NOT Stalled AND NOT pGame->Closing)
+    {
+        Events |= IF (pGame->Length < sizeof(pGame->Buffer)) THEN POLLIN ELSE 0;
+        Events |= IF (pGame->OutLength > 0) THEN POLLOUT ELSE 0;
+    }
+
+    pthread_mutex_unlock(&pGame->Mutex);
+
+    if (Stalled AND NOT pGame->Closing)
+    {
+        server_close(pServer, pGame);
+    }
+
+    return Events;
+}
+
+/*
+ * Queues a line for the client and sends what the socket takes right away. A
+ * line that does not fit means the client stopped reading, so the game is
+ * stopped and left for the main thread to close.
+ */
+static void server_print(void *pContext, const char *pLine)
+{
+    tServerGame *pGame = pContext;
+    size_t Length = strlen(pLine);
+    bool Wake;
+
+    pthread_mutex_lock(&pGame->Mutex);
+
+    if (NOT pGame->Stalled AND pGame->OutLength + Length + 1 <= sizeof(pGame->Output))
+    {
+        memcpy(pGame->Output + pGame->OutLength, pLine, Length);
+        pGame->Output[pGame->OutLength + Length] = '\n';
+        pGame->OutLength += Length + 1;
+
+        server_flush(pGame);
+    }
+    else
+    {
+        pGame->Stalled = true;
+    }
+
+    if (pGame->Stalled)
+    {
+        atomic_store(&pGame->Stop, true);
+    }
+
+    Wake = NOT pGame->Woken AND (pGame->OutLength > 0 OR pGame->Stalled);
+    pGame->Woken = pGame->Woken OR Wake;
+
+    pthread_mutex_unlock(&pGame->Mutex);
+
+    if (Wake)
+    {
+        uint32_t Slot = pGame->Slot | SERVER_WAKE_OUTPUT;
+
+        if (write(pGame->pServer->Wake[1], &Slot, sizeof(Slot)) ISNOT sizeof(Slot))
+        {
+            fprintf(stderr, "[ERROR] Cannot wake the main thread\n");
+        }
+    }
+}
+
+/*
+ * Called with the game's mutex held.
+ */
+static void server_flush(tServerGame *pGame)
+{
+    ssize_t Size = send(pGame->Fd, pGame->Output, pGame->OutLength, MSG_NOSIGNAL);
+
+    if (Size > 0)
+    {
+        memmove(pGame->Output, pGame->Output + Size, pGame->OutLength - Size);
+        pGame->OutLength -= Size;
+    }
+    else if (Size < 0 AND errno ISNOT EAGAIN AND errno ISNOT EWOULDBLOCK AND errno ISNOT EINTR)
+    {
+        pGame->OutLength = 0;
+        pGame->Stalled = true;
+        atomic_store(&pGame->Stop, true);
+    }
+}
+
+static void server_signal(int Signal)
+{
+    ServerSignaled = Signal;
+}
@@ -2,10 +2,12 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "bitutil.h"
 #include "board.h"
 #include "debug.h"
+#include "pathfinder.h"
 #include "types.h"
 #include "util.h"
 
@@ -15,6 +17,11 @@
 
 #define BOARD_LAST_MOVE_INDEX           56
 #define BOARD_MIN_NEIGHBORS_AVAILABLE   6
+#define BOARD_MAX_AREA_LOOPS            6
+#define BOARD_MAX_AREAS                 ((ROWS*COLUMNS + 1) / 2)
+#define BOARD_HASH_DATA                 0x9E3779B97F4A7C15ULL
+#define BOARD_HASH_EMPTY                0xC2B2AE3D27D4EB4FULL
+
 
 static const uint64_t IndicesLookup[ROWS*COLUMNS][2] = {
     { 0x0000000000000082ULL, 0x0000000000000182ULL },
@@ -139,11 +146,24 @@ static const tIndexLookup IndexLookup[ROWS*COLUMNS] = {
 #define TOP(i)          (IndexLookup[i].Top)
 #define BOTTOM(i)       (IndexLookup[i].Bottom)
 
-#ifndef SPEED
-static tSize board_index_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea);
-#endif
+typedef uint64_t tBoardLanes __attribute__((vector_size(BOARD_BATCH_LANES * sizeof(uint64_t))));
+
+typedef struct BoardBatchArea
+{
+    uint64_t Area;
+    tSize Bound;
+}
+tBoardBatchArea;
+
+static tSize board_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea);
 
 static tSize board_index_adjacent_count(uint64_t Data, tIndex Index);
+static void board_batch_scores(const tBoardLanes *pCells, tSize *pScores);
+static tSize board_batch_area_score(uint64_t Data, tBoardBatchArea *pArea, tSize BestScore);
+static tSize board_batch_area_bound(uint64_t Area, uint64_t Leaves);
+static void board_lanes_expand(const tBoardLanes *pLanes, tBoardLanes *pExpanded);
+static bool board_lanes_empty(const tBoardLanes *pLanes);
+static bool board_lanes_equal(const tBoardLanes *pLanes, const tBoardLanes *pL);
 
 void board_init(tBoard *pBoard)
 {
@@ -164,6 +184,15 @@ bool board_equals(tBoard *pBoard, tBoard *pB)
     return pBoard->Data == pB->Data AND pBoard->Empty == pB->Empty;
 }
 
+/*
+ * Multiplicative hash of the cells, whose high bits are the best mixed. The last
+ * move kept in the high bits of Data is left out.
+ */
+uint64_t board_hash(tBoard *pBoard)
+{
+    return (pBoard->Data & BOARD_MASK) * BOARD_HASH_DATA ^ (pBoard->Empty & BOARD_MASK) * BOARD_HASH_EMPTY;
+}
+
 int board_advance(tBoard *pBoard, tIndex Index, bool Player)
 {
     int Res = 0;
@@ -220,7 +249,7 @@ uint64_t board_available_indices(tBoard *pBoard, uint64_t Constraint, bool OnlyN
             Available = Neighbors;
         }
 #else
-        uint64_t Neighbors = 0ULL, Occupied = ~pBoard->Empty;
+        uint64_t Neighbors = 0ULL, Occupied = ~pBoard->Empty & BOARD_MASK;
 
         while (NOT BitEmpty64(Occupied))
         {
@@ -249,6 +278,11 @@ tIndex board_last_move_index(tBoard *pBoard)
 }
 
 tScore board_score(tBoard *pBoard)
+{
+    return board_score_with(pBoard, board_longest_path);
+}
+
+tScore board_score_with(tBoard *pBoard, tBoardLongestPath LongestPath)
 {
     tScore ScoreX = 0, ScoreO = 0;
     uint64_t NotEmpty = ~pBoard->Empty & BOARD_MASK;
@@ -266,15 +300,9 @@ tScore board_score(tBoard *pBoard)
         tScore BestScore = IF Player THEN ScoreX ELSE ScoreO;
         bool ShouldScore = (AdjacentCount == 1 OR AdjacentCount == 2) AND (BitEmpty64(Area) OR BitPopCount64(Area) > BestScore);
 
-#ifdef SPEED
-        tSize Score = IF ShouldScore THEN scorer_longest_path(Data, Index, &Area)
-            ELSE IF (AdjacentCount == 0) THEN 1
-            ELSE 0;
-#else
-        tSize Score = IF ShouldScore THEN board_index_longest_path(Data, Index, &Area)
+        tSize Score = IF ShouldScore THEN LongestPath(Data, Index, &Area)
             ELSE IF (AdjacentCount == 0) THEN 1
             ELSE 0;
-#endif
 
         if (NOT BitEmpty64(Area) AND BitEmpty64(IndexAreas[Index]))
         {
@@ -305,6 +333,73 @@ tScore board_score(tBoard *pBoard)
     return ScoreX - ScoreO;
 }
 
+/*
+ * Scores boards BOARD_BATCH_LANES at a time. The areas of each player are found
+ * with a flood fill that runs on all lanes at once, and an area where no cell
+ * has more than two neighbors is a path or a cycle, so it scores its size. The
+ * longest path is only searched for in the other areas, and only when their
+ * bound can beat the best score of the player.
+ */
+void board_score_batch(const tBoard *pBoards, size_t Count, tScore *pScores)
+{
+    for (size_t i = 0; i < Count; i += BOARD_BATCH_LANES)
+    {
+        tBoardLanes CellsX = { 0ULL }, CellsO = { 0ULL };
+        tSize ScoresX[BOARD_BATCH_LANES], ScoresO[BOARD_BATCH_LANES];
+        size_t Lanes = IF (Count - i < BOARD_BATCH_LANES) THEN Count - i ELSE BOARD_BATCH_LANES;
+
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            uint64_t NotEmpty = ~pBoards[i+l].Empty & BOARD_MASK;
+
+            CellsX[l] = pBoards[i+l].Data & NotEmpty;
+            CellsO[l] = ~pBoards[i+l].Data & NotEmpty;
+        }
+
+        board_batch_scores(&CellsX, ScoresX);
+        board_batch_scores(&CellsO, ScoresO);
+
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            pScores[i+l] = (tScore) ScoresX[l] - (tScore) ScoresO[l];
+        }
+    }
+}
+
+tSize board_index_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea)
+{
+    tSize PathLength, MaxPathLength = 0;
+
+    BitReset64(&Data, Index);
+    BitSet64(pArea, Index);
+
+    if (LEFT_VALID(Index) AND BitTest64(Data, LEFT(Index)))
+    {
+        PathLength = board_index_longest_path(Data, LEFT(Index), pArea);
+        SET_IF_GREATER(PathLength, MaxPathLength);
+    }
+
+    if (RIGHT_VALID(Index) AND BitTest64(Data, RIGHT(Index)))
+    {
+        PathLength = board_index_longest_path(Data, RIGHT(Index), pArea);
+        SET_IF_GREATER(PathLength, MaxPathLength);
+    }
+
+    if (TOP_VALID(Index) AND BitTest64(Data, TOP(Index)))
+    {
+        PathLength = board_index_longest_path(Data, TOP(Index), pArea);
+        SET_IF_GREATER(PathLength, MaxPathLength);
+    }
+    
+    if (BOTTOM_VALID(Index) AND BitTest64(Data, BOTTOM(Index)))
+    {
+        PathLength = board_index_longest_path(Data, BOTTOM(Index), pArea);
+        SET_IF_GREATER(PathLength, MaxPathLength);
+    }
+
+    return MaxPathLength + 1;
+}
+
 char board_index_char(tBoard *pBoard, tIndex Index)
 {
     return IF board_index_empty(pBoard, Index) THEN ' '
@@ -327,46 +422,86 @@ bool board_id_valid(char (*pId)[BOARD_ID_STR_LEN])
 
 char *board_index_id(tIndex Index)
 {
-    char *Str = NULL;
+    char *Str = emalloc(BOARD_ID_STR_LEN * sizeof(char));
+
+    if (board_index_id_to_buf(Index, Str, BOARD_ID_STR_LEN) < 0)
+    {
+        free(Str);
+        Str = NULL;
+    }
+
+    return Str;
+}
+
+/*
+ * Writes the id of the index into the buffer and returns its length, -EINVAL
+ * for an invalid index or -ENOSPC if the buffer is too small.
+ */
+int board_index_id_to_buf(tIndex Index, char *pBuf, size_t Cap)
+{
+    int Res;
+    size_t Length = 0;
 
     if (NOT board_index_valid(Index))
     {
+        Res = -EINVAL;
         dbg_printf(DEBUG_LEVEL_WARN, "Cannot convert index to id with invalid index");
         goto Error;
     }
 
-    Str = emalloc(BOARD_ID_STR_LEN * sizeof(char));
-
-    sprintf(Str, "%c%c", (Index%ROWS)+'a', (ROWS-(Index/ROWS))+'0');
+    Res = bprintf(pBuf, Cap, &Length, "%c%c", (Index%ROWS)+'a', (ROWS-(Index/ROWS))+'0');
 
 Error:
-    return Str;
+    return IF (Res < 0) THEN Res ELSE (int) Length;
 }
 
 char *board_string(tBoard *pBoard)
 {
-    char *Str = emalloc(BOARD_STR_LEN * sizeof(char)), *pBegin = Str;
+    char *Str = emalloc(BOARD_STR_LEN * sizeof(char));
+
+    board_string_to_buf(pBoard, Str, BOARD_STR_LEN);
+
+    return Str;
+}
+
+/*
+ * Writes the board into the buffer and returns its length, or -ENOSPC if the
+ * buffer is smaller than BOARD_STR_LEN.
+ */
+int board_string_to_buf(tBoard *pBoard, char *pBuf, size_t Cap)
+{
+    int Res = 0;
+    size_t Length = 0;
 
     for (tIndex i = 0; i < ROWS*COLUMNS; ++i)
     {
         if (i % ROWS == 0)
         {
-            Str += sprintf(Str, "%d ", ROWS-i/ROWS);
+            Res = bprintf(pBuf, Cap, &Length, "%d ", ROWS-i/ROWS);
+            if (Res < 0)
+            {
+                goto Error;
+            }
         }
 
         char *SqFmt = IF ((i+1) % COLUMNS == 0) THEN "[%c]\n" ELSE "[%c]";
-        
-        Str += sprintf(Str, SqFmt, board_index_char(pBoard, i));
+
+        Res = bprintf(pBuf, Cap, &Length, SqFmt, board_index_char(pBoard, i));
+        if (Res < 0)
+        {
+            goto Error;
+        }
     }
 
-    Str += sprintf(Str, "& ");
+    Res = bprintf(pBuf, Cap, &Length, "& ");
 
-    for (tIndex Col = 0; Col < COLUMNS; ++Col)
+    for (tIndex Col = 0; Col < COLUMNS AND Res == 0; ++Col)
     {
-        Str += sprintf(Str, " %c ", 'a'+Col);
+        Res = bprintf(pBuf, Cap, &Length, " %c ", 'a'+Col);
     }
 
-    return pBegin;
+Error:
+    return IF (Res < 0) THEN Res ELSE (int) Length;
 }
 
 bool board_index_empty(tBoard *pBoard, tIndex Index)
@@ -389,41 +524,37 @@ bool board_index_player(tBoard *pBoard, tIndex Index)
     return BitTest64(pBoard->Data, Index);
 }
 
-#ifndef SPEED
-static tSize board_index_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea)
+uint64_t board_index_adjacent(tIndex Index)
 {
-    tSize PathLength, MaxPathLength = 0;
-
-    BitReset64(&Data, Index);
-    BitSet64(pArea, Index);
+    return ADJACENT_INDICES(Index);
+}
 
-    if (LEFT_VALID(Index) AND BitTest64(Data, LEFT(Index)))
-    {
-        PathLength = board_index_longest_path(Data, LEFT(Index), pArea);
-        SET_IF_GREATER(PathLength, MaxPathLength);
-    }
+/*
+ * A capped search may fall short of the longest path, so the area is then
+ * scored exactly after all.
+ */
+static tSize board_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea)
+{
+    tSize PathLength = 0;
+    uint64_t Area = IF BitEmpty64(*pArea) THEN pathfinder_area(Data, Index) ELSE *pArea;
+    bool Search = pathfinder_area_loops(Area) >= BOARD_MAX_AREA_LOOPS, Capped = false;
 
-    if (RIGHT_VALID(Index) AND BitTest64(Data, RIGHT(Index)))
+    if (Search)
     {
-        PathLength = board_index_longest_path(Data, RIGHT(Index), pArea);
-        SET_IF_GREATER(PathLength, MaxPathLength);
+        PathLength = pathfinder_search(Data, Index, pArea, &Capped);
     }
 
-    if (TOP_VALID(Index) AND BitTest64(Data, TOP(Index)))
+    if (NOT Search OR Capped)
     {
-        PathLength = board_index_longest_path(Data, TOP(Index), pArea);
-        SET_IF_GREATER(PathLength, MaxPathLength);
-    }
-    
-    if (BOTTOM_VALID(Index) AND BitTest64(Data, BOTTOM(Index)))
-    {
-        PathLength = board_index_longest_path(Data, BOTTOM(Index), pArea);
-        SET_IF_GREATER(PathLength, MaxPathLength);
+#ifdef SPEED
+        PathLength = scorer_longest_path(Data, Index, pArea);
+#else
+        PathLength = board_index_longest_path(Data, Index, pArea);
+#endif
     }
 
-    return MaxPathLength + 1;
+    return PathLength;
 }
-#endif
 
 static tSize board_index_adjacent_count(uint64_t Data, tIndex Index)
 {
@@ -432,3 +563,137 @@ static tSize board_index_adjacent_count(uint64_t Data, tIndex Index)
          + (TOP_VALID(Index) AND BitTest64(Data, TOP(Index)))
          + (BOTTOM_VALID(Index) AND BitTest64(Data, BOTTOM(Index)));
 }
+
+static void board_batch_scores(const tBoardLanes *pCells, tSize *pScores)
+{
+    tBoardBatchArea Areas[BOARD_BATCH_LANES][BOARD_MAX_AREAS];
+    tSize AreaCounts[BOARD_BATCH_LANES] = { 0 };
+    tBoardLanes Remaining = *pCells;
+
+    for (int l = 0; l < BOARD_BATCH_LANES; ++l)
+    {
+        pScores[l] = 0;
+    }
+
+    while (NOT board_lanes_empty(&Remaining))
+    {
+        tBoardLanes Area = Remaining & -Remaining, Prev, Expanded;
+
+        do
+        {
+            Prev = Area;
+            board_lanes_expand(&Area, &Expanded);
+            Area |= Expanded & Remaining;
+        }
+        while (NOT board_lanes_equal(&Area, &Prev));
+
+        Remaining &= ~Area;
+
+        tBoardLanes Left = (Area << 1) & ~BOARD_COLUMN_A & Area;
+        tBoardLanes Right = (Area >> 1) & ~BOARD_COLUMN_G & Area;
+        tBoardLanes Top = (Area << COLUMNS) & Area;
+        tBoardLanes Bottom = (Area >> COLUMNS) & Area;
+        tBoardLanes Multiple = (Left & Right) | (Top & Bottom) | ((Left | Right) & (Top | Bottom));
+        tBoardLanes Branches = (Left & Right & (Top | Bottom)) | (Top & Bottom & (Left | Right));
+        tBoardLanes Leaves = (Left | Right | Top | Bottom) & ~Multiple;
+
+        for (int l = 0; l < BOARD_BATCH_LANES; ++l)
+        {
+            tSize Size = BitPopCount64(Area[l]);
+
+            if (BitEmpty64(Branches[l]))
+            {
+                SET_IF_GREATER(Size, pScores[l]);
+            }
+            else
+            {
+                tBoardBatchArea *pArea = &Areas[l][AreaCounts[l]++];
+
+                pArea->Area = Area[l];
+                pArea->Bound = board_batch_area_bound(Area[l], Leaves[l]);
+            }
+        }
+    }
+
+    for (int l = 0; l < BOARD_BATCH_LANES; ++l)
+    {
+        for (tSize a = 0; a < AreaCounts[l]; ++a)
+        {
+            if (Areas[l][a].Bound > pScores[l])
+            {
+                pScores[l] = board_batch_area_score((*pCells)[l], &Areas[l][a], pScores[l]);
+            }
+        }
+    }
+}
+
+static tSize board_batch_area_score(uint64_t Data, tBoardBatchArea *pArea, tSize BestScore)
+{
+    uint64_t Indices = pArea->Area;
+
+    while (NOT BitEmpty64(Indices) AND BestScore < pArea->Bound)
+    {
+        tIndex Index = BitTzCount64(Indices);
+        tSize AdjacentCount = board_index_adjacent_count(Data, Index);
+
+        if (AdjacentCount == 1 OR AdjacentCount == 2)
+        {
+            uint64_t Area = pArea->Area;
+            tSize Score = board_longest_path(Data, Index, &Area);
+
+            SET_IF_GREATER(Score, BestScore);
+        }
+
+        BitReset64(&Indices, Index);
+    }
+
+    return BestScore;
+}
+
+/*
+ * A path can end on at most two cells with a single neighbor and alternates
+ * between the two colors of the board.
+ */
+static tSize board_batch_area_bound(uint64_t Area, uint64_t Leaves)
+{
+    tSize Bound = BitPopCount64(Area);
+    tSize LeafCount = BitPopCount64(Leaves);
+    tSize EvenCount = BitPopCount64(Area & BOARD_EVEN_MASK), OddCount = Bound - EvenCount;
+    tSize ColorCount = IF (EvenCount < OddCount) THEN EvenCount ELSE OddCount;
+
+    if (LeafCount > 2)
+    {
+        Bound -= LeafCount - 2;
+    }
+
+    if (2 * ColorCount + 1 < Bound)
+    {
+        Bound = 2 * ColorCount + 1;
+    }
+
+    return Bound;
+}
+
+static void board_lanes_expand(const tBoardLanes *pLanes, tBoardLanes *pExpanded)
+{
+    *pExpanded = BOARD_EXPAND(*pLanes);
+}
+
+static bool board_lanes_empty(const tBoardLanes *pLanes)
+{
+    uint64_t Bits = 0ULL;
+
+    for (int l = 0; l < BOARD_BATCH_LANES; ++l)
+    {
+        Bits |= (*pLanes)[l];
+    }
+
+    return BitEmpty64(Bits);
+}
+
+static bool board_lanes_equal(const tBoardLanes *pLanes, const tBoardLanes *pL)
+{
+    tBoardLanes Difference = *pLanes ^ *pL;
+
+    return board_lanes_empty(&Difference);
+}
@@ -2,6 +2,7 @@
 #define __BOARD_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "types.h"
@@ -10,10 +11,25 @@
 #define COLUMNS 7
 
 #define BOARD_ID_STR_LEN    3
-#define BOARD_STR_LEN       190
+#define BOARD_STR_LEN       192
 
 #define BOARD_MASK  0x0001FFFFFFFFFFFFULL
 
+#define BOARD_COLUMN_A      0x0000040810204081ULL
+#define BOARD_COLUMN_G      0x0001020408102040ULL
+#define BOARD_EVEN_MASK     0x0001555555555555ULL
+
+/*
+ * Adds the orthogonal neighbors of every cell in Bits. It is a macro so that it
+ * stays inline in the hot loops and applies to batch lanes as well.
+ */
+#define BOARD_EXPAND(Bits)  (((((Bits) >> 1) & ~BOARD_COLUMN_G) \
+                            | (((Bits) << 1) & ~BOARD_COLUMN_A) \
+                            | ((Bits) >> COLUMNS)                \
+                            | ((Bits) << COLUMNS)) & BOARD_MASK)
+
+#define BOARD_BATCH_LANES   4
+
 typedef struct
 #ifdef PACKED
 __attribute__((packed))
@@ -28,22 +44,31 @@ Board
 }
 tBoard;
 
+typedef tSize (*tBoardLongestPath)(uint64_t Data, tIndex Index, uint64_t *pArea);
+
 void board_init(tBoard *pBoard);
 void board_copy(tBoard *pBoard, tBoard *pB);
 bool board_equals(tBoard *pBoard, tBoard *pB);
+uint64_t board_hash(tBoard *pBoard);
 int board_advance(tBoard *pBoard, tIndex Index, bool Player);
 bool board_finished(tBoard *pBoard);
 tSize board_move(tBoard *pBoard);
 uint64_t board_available_indices(tBoard *pBoard, uint64_t Constraint, bool OnlyNeighbors);
 tIndex board_last_move_index(tBoard *pBoard);
 tScore board_score(tBoard *pBoard);
+tScore board_score_with(tBoard *pBoard, tBoardLongestPath LongestPath);
+void board_score_batch(const tBoard *pBoards, size_t Count, tScore *pScores);
+tSize board_index_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea);
 char *board_string(tBoard *pBoard);
+int board_string_to_buf(tBoard *pBoard, char *pBuf, size_t Cap);
 char board_index_char(tBoard *pBoard, tIndex Index);
 tIndex board_id_index(char (*pId)[BOARD_ID_STR_LEN]);
 char *board_index_id(tIndex Index);
+int board_index_id_to_buf(tIndex Index, char *pBuf, size_t Cap);
 bool board_id_valid(char (*pId)[BOARD_ID_STR_LEN]);
 bool board_index_valid(tIndex Index);
 bool board_index_empty(tBoard *pBoard, tIndex Index);
 bool board_index_player(tBoard *pBoard, tIndex Index);
+uint64_t board_index_adjacent(tIndex Index);
 
 #endif
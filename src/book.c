@@ -0,0 +1,213 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "book.h"
+#include "debug.h"
+#include "rules.h"
+#include "types.h"
+#include "util.h"
+
+#define BOOK_INDEX_BITS     6
+#define BOOK_INDEX_MASK     ((1ULL << BOOK_INDEX_BITS) - 1)
+
+#define BOOK_HASH_RULES     0x165667B19E3779F9ULL
+#define BOOK_HASH_MIX       0xBF58476D1CE4E5B9ULL
+
+static uint64_t book_hash(eRulesType RulesType, tBoard *pBoard);
+static int book_compare(const void *pA, const void *pB);
+
+/*
+ * A book is a header followed by entries sorted in ascending order. Each entry
+ * is a 64-bit hash of the ruleset and board, with its low bits replaced by the
+ * index of the move to play, so a lookup is a binary search over the mapped
+ * file. An empty file name leaves the book empty.
+ */
+int book_init(tBook *pBook, tRulesConfig *pRulesConfig, tBookConfig *pConfig)
+{
+    int Res = 0, Fd;
+    struct stat Stat;
+    const tBookHeader *pHeader;
+
+    pBook->pMap = NULL;
+    pBook->MapSize = 0;
+    pBook->pEntries = NULL;
+    pBook->Size = 0;
+    pBook->RulesType = pRulesConfig->RulesType;
+
+    if (pConfig->File[0] == '\0')
+    {
+        goto Error;
+    }
+
+    Fd = open(pConfig->File, O_RDONLY);
+    if (Fd < 0)
+    {
+        Res = -errno;
+        fprintf(stderr, "[ERROR] Cannot open file \"%s\"\n", pConfig->File);
+        goto Error;
+    }
+
+    if (fstat(Fd, &Stat) < 0 OR Stat.st_size < (off_t) sizeof(tBookHeader))
+    {
+        Res = -EINVAL;
+        dbg_printf(DEBUG_LEVEL_ERROR, "Invalid book \"%s\"", pConfig->File);
+        goto Close;
+    }
+
+    pBook->pMap = mmap(NULL, Stat.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+    if (pBook->pMap == MAP_FAILED)
+    {
+        Res = -errno;
+        pBook->pMap = NULL;
+        dbg_printf(DEBUG_LEVEL_ERROR, "Cannot map book \"%s\"", pConfig->File);
+        goto Close;
+    }
+
+    pBook->MapSize = Stat.st_size;
+    pHeader = pBook->pMap;
+
+    if (memcmp(pHeader->Magic, BOOK_MAGIC, sizeof(pHeader->Magic)) ISNOT 0 OR pHeader->Version ISNOT BOOK_VERSION
+        OR pHeader->Size ISNOT (Stat.st_size - sizeof(tBookHeader)) / sizeof(uint64_t))
+    {
+        Res = -EINVAL;
+        dbg_printf(DEBUG_LEVEL_ERROR, "Invalid book \"%s\"", pConfig->File);
+        book_free(pBook);
+        goto Close;
+    }
+
+    pBook->pEntries = (const uint64_t *) (pHeader + 1);
+    pBook->Size = pHeader->Size;
+
+Close:
+    close(Fd);
+
+Error:
+    return Res;
+}
+
+void book_config_init(tBookConfig *pConfig)
+{
+    pConfig->File[0] = '\0';
+}
+
+void book_free(tBook *pBook)
+{
+    if (pBook->pMap ISNOT NULL)
+    {
+        munmap(pBook->pMap, pBook->MapSize);
+    }
+
+    pBook->pMap = NULL;
+    pBook->pEntries = NULL;
+    pBook->Size = 0;
+}
+
+/*
+ * Returns the index of the book move for the position, or -ENOENT if the
+ * position is not in the book.
+ */
+int book_lookup(tBook *pBook, tBoard *pBoard)
+{
+    int Res = -ENOENT;
+    uint64_t Hash = book_hash(pBook->RulesType, pBoard);
+    uint64_t Low = 0, High = pBook->Size;
+
+    while (Res == -ENOENT AND Low < High)
+    {
+        uint64_t Middle = Low + (High - Low) / 2;
+        uint64_t Entry = pBook->pEntries[Middle] & ~BOOK_INDEX_MASK;
+
+        if (Entry == Hash)
+        {
+            Res = pBook->pEntries[Middle] & BOOK_INDEX_MASK;
+        }
+        else if (Entry < Hash)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    return Res;
+}
+
+uint64_t book_entry(eRulesType RulesType, tBoard *pBoard, tIndex Index)
+{
+    return book_hash(RulesType, pBoard) | Index;
+}
+
+/*
+ * Sorts the entries and writes them as a book. Entries for a position that is
+ * already in the book are dropped.
+ */
+int book_write(const char *pFile, uint64_t *pEntries, uint64_t Size)
+{
+    int Res = 0;
+    uint64_t Unique = 0;
+    tBookHeader Header;
+    FILE *pOut;
+
+    qsort(pEntries, Size, sizeof(uint64_t), book_compare);
+
+    for (uint64_t i = 0; i < Size; ++i)
+    {
+        if (Unique == 0 OR (pEntries[i] & ~BOOK_INDEX_MASK) ISNOT (pEntries[Unique-1] & ~BOOK_INDEX_MASK))
+        {
+            pEntries[Unique++] = pEntries[i];
+        }
+    }
+
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, BOOK_MAGIC, sizeof(Header.Magic));
+    Header.Version = BOOK_VERSION;
+    Header.Size = Unique;
+
+    pOut = fopen(pFile, "wb");
+    if (pOut IS NULL)
+    {
+        Res = -errno;
+        goto Error;
+    }
+
+    if (fwrite(&Header, sizeof(Header), 1, pOut) ISNOT 1 OR fwrite(pEntries, sizeof(uint64_t), Unique, pOut) ISNOT Unique)
+    {
+        Res = -EIO;
+    }
+
+    if (fclose(pOut) ISNOT 0 AND Res == 0)
+    {
+        Res = -errno;
+    }
+
+Error:
+    return Res;
+}
+
+static uint64_t book_hash(eRulesType RulesType, tBoard *pBoard)
+{
+    uint64_t Hash = board_hash(pBoard) ^ (uint64_t) RulesType * BOOK_HASH_RULES;
+
+    Hash ^= Hash >> 31;
+    Hash *= BOOK_HASH_MIX;
+    Hash ^= Hash >> 29;
+
+    return Hash & ~BOOK_INDEX_MASK;
+}
+
+static int book_compare(const void *pA, const void *pB)
+{
+    uint64_t A = *(const uint64_t *) pA, B = *(const uint64_t *) pB;
+
+    return (A > B) - (A < B);
+}
@@ -0,0 +1,46 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "rules.h"
+#include "types.h"
+
+#define BOOK_FILE_LEN   128
+#define BOOK_MAGIC      "TTBK"
+#define BOOK_VERSION    1
+
+typedef struct BookConfig
+{
+    char File[BOOK_FILE_LEN];
+}
+tBookConfig;
+
+typedef struct BookHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint64_t Size;
+}
+tBookHeader;
+
+typedef struct Book
+{
+    void *pMap;
+    size_t MapSize;
+    const uint64_t *pEntries;
+    uint64_t Size;
+    eRulesType RulesType;
+}
+tBook;
+
+int book_init(tBook *pBook, tRulesConfig *pRulesConfig, tBookConfig *pConfig);
+void book_config_init(tBookConfig *pConfig);
+void book_free(tBook *pBook);
+int book_lookup(tBook *pBook, tBoard *pBoard);
+uint64_t book_entry(eRulesType RulesType, tBoard *pBoard, tIndex Index);
+int book_write(const char *pFile, uint64_t *pEntries, uint64_t Size);
+
+#endif
@@ -7,8 +7,11 @@
 #include <string.h>
 
 #include "board.h"
+#include "book.h"
 #include "config.h"
 #include "debug.h"
+#include "endgame.h"
+#include "engine.h"
 #include "rules.h"
 #include "types.h"
 #include "util.h"
@@ -21,9 +24,21 @@
 #define CONFIG_SIMULATIONS              "SIMULATIONS"
 #define CONFIG_SEARCH_ONLY_NEIGHBORS    "SEARCH_ONLY_NEIGHBORS"
 #define CONFIG_STARTING_MOVES           "STARTING_MOVES"
+#define CONFIG_RAVE_EQUIVALENCE         "RAVE_EQUIVALENCE"
+#define CONFIG_ENDGAME_EMPTY_SQUARES    "ENDGAME_EMPTY_SQUARES"
+#define CONFIG_PROGRESSIVE_WIDENING     "PROGRESSIVE_WIDENING"
+#define CONFIG_MEMORY_BUDGET            "MEMORY_BUDGET"
+#define CONFIG_MEMORY_MODE              "MEMORY_MODE"
+#define CONFIG_BACKGROUND_FREE          "BACKGROUND_FREE"
+#define CONFIG_PRIOR_EXPLORATION        "PRIOR_EXPLORATION"
+#define CONFIG_BOOK_FILE                "BOOK_FILE"
 
 #define CONFIG_MAXLINE              128
 #define CONFIG_MAX_MOVES_STR_LEN    (ROWS*COLUMNS*2)
+#define CONFIG_MAX_MEMORY_BUDGET    (1 << 20)
+#define CONFIG_MEGABYTE             (1 << 20)
+#define CONFIG_MAX_PRIOR_EXPLORATION    10000
+#define CONFIG_PERCENT                  100.0f
 
 #define CONFIG_STRNCMP(pKey, Param) (strncmp(pKey, Param, sizeof(Param)) == 0)
 
@@ -38,6 +53,8 @@ int config_init(tConfig *pConfig)
 
     rules_config_init(&pConfig->RulesConfig);
     mcts_config_init(&pConfig->MctsConfig);
+    endgame_config_init(&pConfig->EndgameConfig);
+    book_config_init(&pConfig->BookConfig);
 
     Res = vector_init(&pConfig->StartingMoves);
 
@@ -54,6 +71,21 @@ void config_free(tConfig *pConfig)
     vector_free(&pConfig->StartingMoves);
 }
 
+void config_engine(tConfig *pConfig, tEngineConfig *pEngineConfig)
+{
+    pEngineConfig->RulesType = pConfig->RulesConfig.RulesType;
+    pEngineConfig->Simulations = pConfig->MctsConfig.Simulations;
+    pEngineConfig->SearchOnlyNeighbors = pConfig->MctsConfig.SearchOnlyNeighbors;
+    pEngineConfig->RaveEquivalence = pConfig->MctsConfig.RaveEquivalence;
+    pEngineConfig->Widening = pConfig->MctsConfig.Widening;
+    pEngineConfig->MemoryBudget = pConfig->MctsConfig.MemoryBudget;
+    pEngineConfig->MemoryMode = pConfig->MctsConfig.MemoryMode;
+    pEngineConfig->BackgroundFree = pConfig->MctsConfig.BackgroundFree;
+    pEngineConfig->PriorExploration = pConfig->MctsConfig.PriorExploration;
+    pEngineConfig->EndgameEmptySquares = pConfig->EndgameConfig.EmptySquares;
+    pEngineConfig->pBookFile = pConfig->BookConfig.File;
+}
+
 int config_load(tConfig *pConfig)
 {
     int Res = 0, Line = 0, Val = 0;
@@ -63,9 +95,9 @@ int config_load(tConfig *pConfig)
     
     struct
     {
-        bool ComputerPlaying, ComputerPlayer, RulesType, Simulations, SearchOnlyNeighbors, StartPosition;
+        bool ComputerPlaying, ComputerPlayer, RulesType, Simulations, SearchOnlyNeighbors, StartPosition, RaveEquivalence, EndgameEmptySquares, ProgressiveWidening, MemoryBudget, MemoryMode, BackgroundFree, PriorExploration, BookFile;
     }
-    Found = { false, false, false, false, false, false };
+    Found = { false, false, false, false, false, false, false, false, false, false, false, false, false, false };
 
     if ((pFile = fopen(CONFIG_FILENAME, "r")) ISNOT NULL)
     {
@@ -105,6 +137,20 @@ int config_load(tConfig *pConfig)
                 continue;
             }
 
+            if (NOT Found.BookFile AND CONFIG_STRNCMP(pKey, CONFIG_BOOK_FILE))
+            {
+                if (strlen(pValue) >= BOOK_FILE_LEN)
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                strcpy(pConfig->BookConfig.File, pValue);
+
+                Found.BookFile = true;
+                continue;
+            }
+
             Val = strtol(pValue, &pEnd, 10);
 
             if (pValue == pEnd)
@@ -229,6 +275,112 @@ int config_load(tConfig *pConfig)
 
                 Found.SearchOnlyNeighbors = true;
             }
+            else if (NOT Found.RaveEquivalence AND CONFIG_STRNCMP(pKey, CONFIG_RAVE_EQUIVALENCE))
+            {
+                if (Val >= 0 AND Val <= TVISITS_MAX)
+                {
+                    pConfig->MctsConfig.RaveEquivalence = Val;
+                }
+                else 
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                Found.RaveEquivalence = true;
+            }
+            else if (NOT Found.EndgameEmptySquares AND CONFIG_STRNCMP(pKey, CONFIG_ENDGAME_EMPTY_SQUARES))
+            {
+                if (Val >= 0 AND Val <= ROWS*COLUMNS)
+                {
+                    pConfig->EndgameConfig.EmptySquares = Val;
+                }
+                else 
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                Found.EndgameEmptySquares = true;
+            }
+            else if (NOT Found.ProgressiveWidening AND CONFIG_STRNCMP(pKey, CONFIG_PROGRESSIVE_WIDENING))
+            {
+                if (Val >= 0 AND Val <= ROWS*COLUMNS)
+                {
+                    pConfig->MctsConfig.Widening = Val;
+                }
+                else 
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                Found.ProgressiveWidening = true;
+            }
+            else if (NOT Found.MemoryBudget AND CONFIG_STRNCMP(pKey, CONFIG_MEMORY_BUDGET))
+            {
+                if (Val >= 0 AND Val <= CONFIG_MAX_MEMORY_BUDGET)
+                {
+                    pConfig->MctsConfig.MemoryBudget = (size_t) Val * CONFIG_MEGABYTE;
+                }
+                else 
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                Found.MemoryBudget = true;
+            }
+            else if (NOT Found.MemoryMode AND CONFIG_STRNCMP(pKey, CONFIG_MEMORY_MODE))
+            {
+                if (Val == MCTS_MEMORY_STOP)
+                {
+                    pConfig->MctsConfig.MemoryMode = MCTS_MEMORY_STOP;
+                }
+                else if (Val == MCTS_MEMORY_PRUNE)
+                {
+                    pConfig->MctsConfig.MemoryMode = MCTS_MEMORY_PRUNE;
+                }
+                else
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                Found.MemoryMode = true;
+            }
+            else if (NOT Found.BackgroundFree AND CONFIG_STRNCMP(pKey, CONFIG_BACKGROUND_FREE))
+            {
+                if (Val == 0)
+                {
+                    pConfig->MctsConfig.BackgroundFree = false;
+                }
+                else if (Val == 1)
+                {
+                    pConfig->MctsConfig.BackgroundFree = true;
+                }
+                else
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                Found.BackgroundFree = true;
+            }
+            else if (NOT Found.PriorExploration AND CONFIG_STRNCMP(pKey, CONFIG_PRIOR_EXPLORATION))
+            {
+                if (Val >= 0 AND Val <= CONFIG_MAX_PRIOR_EXPLORATION)
+                {
+                    pConfig->MctsConfig.PriorExploration = Val / CONFIG_PERCENT;
+                }
+                else 
+                {
+                    Res = -EINVAL;
+                    goto Error;
+                }
+
+                Found.PriorExploration = true;
+            }
             else
             {
                 Res = -EINVAL;
@@ -248,6 +400,14 @@ int config_load(tConfig *pConfig)
     dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_RULES_TYPE, pConfig->RulesConfig.RulesType);
     dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_SIMULATIONS, pConfig->MctsConfig.Simulations);
     dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_SEARCH_ONLY_NEIGHBORS, pConfig->MctsConfig.SearchOnlyNeighbors);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_RAVE_EQUIVALENCE, pConfig->MctsConfig.RaveEquivalence);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_ENDGAME_EMPTY_SQUARES, pConfig->EndgameConfig.EmptySquares);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_PROGRESSIVE_WIDENING, pConfig->MctsConfig.Widening);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %zu", CONFIG_MEMORY_BUDGET, pConfig->MctsConfig.MemoryBudget / CONFIG_MEGABYTE);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_MEMORY_MODE, pConfig->MctsConfig.MemoryMode);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %d", CONFIG_BACKGROUND_FREE, pConfig->MctsConfig.BackgroundFree);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %.2f", CONFIG_PRIOR_EXPLORATION, pConfig->MctsConfig.PriorExploration);
+    dbg_printf(DEBUG_LEVEL_INFO, "%s: %s", CONFIG_BOOK_FILE, pConfig->BookConfig.File);
 
     goto Success;
 
@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 
+#include "book.h"
+#include "endgame.h"
+#include "engine.h"
 #include "mcts.h"
 #include "rules.h"
 #include "vector.h"
@@ -13,12 +16,15 @@ typedef struct Config
     bool ComputerPlayer;
     tRulesConfig RulesConfig;
     tMctsConfig MctsConfig;
+    tEndgameConfig EndgameConfig;
+    tBookConfig BookConfig;
     tVector StartingMoves;
 } 
 tConfig;
 
 int config_init(tConfig *pConfig);
 void config_free(tConfig *pConfig);
+void config_engine(tConfig *pConfig, tEngineConfig *pEngineConfig);
 int config_load(tConfig *pConfig);
 
 #endif
@@ -0,0 +1,248 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bitutil.h"
+#include "board.h"
+#include "debug.h"
+#include "endgame.h"
+#include "rules.h"
+#include "types.h"
+#include "util.h"
+
+#define ENDGAME_SCORE_MAX   (ROWS*COLUMNS)
+#define ENDGAME_NO_INDEX    (ROWS*COLUMNS)
+
+typedef enum EndgameBound
+{
+    ENDGAME_BOUND_NONE  = 0,
+    ENDGAME_BOUND_EXACT = 1,
+    ENDGAME_BOUND_LOWER = 2,
+    ENDGAME_BOUND_UPPER = 3,
+}
+eEndgameBound;
+
+static tScore endgame_search(tEndgame *pEndgame, tBoard *pBoard, tScore Alpha, tScore Beta, tIndex *pIndex);
+static tSize endgame_order(tBoard *pBoard, uint64_t Indices, bool Player, tIndex Hint, tIndex *pMoves);
+static tEndgameEntry *endgame_entry(tEndgame *pEndgame, tBoard *pBoard);
+
+void endgame_init(tEndgame *pEndgame, tRules *pRules, tEndgameConfig *pConfig)
+{
+    pEndgame->pTable = NULL;
+    pEndgame->pRules = pRules;
+    pEndgame->Config = *pConfig;
+
+    if (pEndgame->Config.EmptySquares > 0)
+    {
+        pEndgame->pTable = emalloc(ENDGAME_TABLE_SIZE * sizeof(tEndgameEntry));
+        endgame_clear(pEndgame);
+    }
+}
+
+void endgame_config_init(tEndgameConfig *pConfig)
+{
+    pConfig->EmptySquares = 0;
+}
+
+void endgame_free(tEndgame *pEndgame)
+{
+    free(pEndgame->pTable);
+}
+
+/*
+ * Empties the table without freeing it, for when the rules change, as entries
+ * are only keyed by the board.
+ */
+void endgame_clear(tEndgame *pEndgame)
+{
+    for (uint32_t i = 0; pEndgame->pTable ISNOT NULL AND i < ENDGAME_TABLE_SIZE; ++i)
+    {
+        pEndgame->pTable[i].Bound = ENDGAME_BOUND_NONE;
+    }
+}
+
+bool endgame_active(tEndgame *pEndgame, tBoard *pBoard)
+{
+    return pEndgame->pTable ISNOT NULL AND ROWS*COLUMNS - board_move(pBoard) <= pEndgame->Config.EmptySquares;
+}
+
+/*
+ * Solves the position exactly and returns the best move for the player to move,
+ * with the final score under perfect play from X's perspective in pScore. The
+ * table is kept between moves, since every entry is keyed by the full board.
+ */
+int endgame_solve(tEndgame *pEndgame, tBoard *pBoard, tScore *pScore)
+{
+    int Res = 0;
+    tIndex Index = ENDGAME_NO_INDEX;
+
+    if (pEndgame->pTable IS NULL OR board_finished(pBoard))
+    {
+        Res = -EINVAL;
+        dbg_printf(DEBUG_LEVEL_WARN, "Cannot solve endgame");
+        goto Error;
+    }
+
+    *pScore = endgame_search(pEndgame, pBoard, -ENDGAME_SCORE_MAX, ENDGAME_SCORE_MAX, &Index);
+
+    if (Index == ENDGAME_NO_INDEX)
+    {
+        Res = -ENODATA;
+        goto Error;
+    }
+
+    Res = Index;
+
+Error:
+    return Res;
+}
+
+/*
+ * Alpha-beta over the exact score. Turns do not alternate under every ruleset,
+ * so X maximizes and O minimizes based on the move policy rather than by
+ * negating the score at every ply.
+ */
+static tScore endgame_search(tEndgame *pEndgame, tBoard *pBoard, tScore Alpha, tScore Beta, tIndex *pIndex)
+{
+    tScore Res, AlphaStart, BetaStart;
+    tEndgameEntry *pEntry;
+    uint64_t Data = pBoard->Data & BOARD_MASK, Indices;
+    tIndex Moves[ROWS*COLUMNS], Hint = ENDGAME_NO_INDEX, BestIndex = ENDGAME_NO_INDEX;
+    tSize Size;
+    bool Player;
+
+    if (board_finished(pBoard))
+    {
+        Res = board_score(pBoard);
+        goto Error;
+    }
+
+    pEntry = endgame_entry(pEndgame, pBoard);
+
+    if (pEntry->Bound ISNOT ENDGAME_BOUND_NONE AND pEntry->Data == Data AND pEntry->Empty == pBoard->Empty)
+    {
+        Hint = pEntry->Index;
+
+        if (pIndex IS NULL)
+        {
+            if (pEntry->Bound == ENDGAME_BOUND_EXACT)
+            {
+                Res = pEntry->Score;
+                goto Error;
+            }
+            else if (pEntry->Bound == ENDGAME_BOUND_LOWER)
+            {
+                SET_IF_GREATER(pEntry->Score, Alpha);
+            }
+            else
+            {
+                Beta = IF (pEntry->Score < Beta) THEN pEntry->Score ELSE Beta;
+            }
+
+            if (Alpha >= Beta)
+            {
+                Res = pEntry->Score;
+                goto Error;
+            }
+        }
+    }
+
+    Player = rules_player(pEndgame->pRules, pBoard);
+    Indices = rules_indices(pEndgame->pRules, pBoard, false);
+    Size = endgame_order(pBoard, Indices, Player, Hint, Moves);
+    AlphaStart = Alpha;
+    BetaStart = Beta;
+    Res = IF Player THEN -ENDGAME_SCORE_MAX - 1 ELSE ENDGAME_SCORE_MAX + 1;
+
+    for (tSize i = 0; i < Size; ++i)
+    {
+        tBoard Child = *pBoard;
+
+        board_advance(&Child, Moves[i], Player);
+
+        tScore Score = endgame_search(pEndgame, &Child, Alpha, Beta, NULL);
+
+        if (IF Player THEN Score > Res ELSE Score < Res)
+        {
+            Res = Score;
+            BestIndex = Moves[i];
+        }
+
+        if (Player)
+        {
+            SET_IF_GREATER(Score, Alpha);
+        }
+        else
+        {
+            Beta = IF (Score < Beta) THEN Score ELSE Beta;
+        }
+
+        if (Alpha >= Beta)
+        {
+            break;
+        }
+    }
+
+    if (BestIndex == ENDGAME_NO_INDEX)
+    {
+        Res = board_score(pBoard);
+        goto Error;
+    }
+
+    pEntry = endgame_entry(pEndgame, pBoard);
+    pEntry->Data = Data;
+    pEntry->Empty = pBoard->Empty;
+    pEntry->Score = Res;
+    pEntry->Index = BestIndex;
+    pEntry->Bound = IF (Res <= AlphaStart) THEN ENDGAME_BOUND_UPPER
+        ELSE IF (Res >= BetaStart) THEN ENDGAME_BOUND_LOWER
+        ELSE ENDGAME_BOUND_EXACT;
+
+    if (pIndex ISNOT NULL)
+    {
+        *pIndex = BestIndex;
+    }
+
+Error:
+    return Res;
+}
+
+/*
+ * Tries the table move first, then moves that extend the player's own trains,
+ * then moves that block the opponent's.
+ */
+static tSize endgame_order(tBoard *pBoard, uint64_t Indices, bool Player, tIndex Hint, tIndex *pMoves)
+{
+    uint64_t NotEmpty = ~pBoard->Empty & BOARD_MASK;
+    uint64_t Own = IF Player THEN pBoard->Data & NotEmpty ELSE ~pBoard->Data & NotEmpty;
+    uint64_t Other = NotEmpty & ~Own;
+    tSize Keys[ROWS*COLUMNS], Size = 0;
+
+    while (NOT BitEmpty64(Indices))
+    {
+        tIndex Index = BitTzCount64(Indices);
+        uint64_t Adjacent = board_index_adjacent(Index);
+        tSize Key = IF (Index == Hint) THEN UINT8_MAX
+            ELSE 2 * BitPopCount64(Adjacent & Own) + BitPopCount64(Adjacent & Other);
+        tSize i = Size++;
+
+        for (; i > 0 AND Keys[i-1] < Key; --i)
+        {
+            Keys[i] = Keys[i-1];
+            pMoves[i] = pMoves[i-1];
+        }
+
+        Keys[i] = Key;
+        pMoves[i] = Index;
+
+        BitReset64(&Indices, Index);
+    }
+
+    return Size;
+}
+
+static tEndgameEntry *endgame_entry(tEndgame *pEndgame, tBoard *pBoard)
+{
+    return &pEndgame->pTable[board_hash(pBoard) >> (64 - ENDGAME_TABLE_BITS)];
+}
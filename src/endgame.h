@@ -0,0 +1,45 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "rules.h"
+#include "types.h"
+
+#define ENDGAME_TABLE_BITS  18
+#define ENDGAME_TABLE_SIZE  (1U << ENDGAME_TABLE_BITS)
+
+typedef struct EndgameConfig
+{
+    tSize EmptySquares;
+}
+tEndgameConfig;
+
+typedef struct EndgameEntry
+{
+    uint64_t Data;
+    uint64_t Empty;
+    tScore Score;
+    uint8_t Bound;
+    tIndex Index;
+}
+tEndgameEntry;
+
+typedef struct Endgame
+{
+    tEndgameEntry *pTable;
+    tRules *pRules;
+    tEndgameConfig Config;
+}
+tEndgame;
+
+void endgame_init(tEndgame *pEndgame, tRules *pRules, tEndgameConfig *pConfig);
+void endgame_config_init(tEndgameConfig *pConfig);
+void endgame_free(tEndgame *pEndgame);
+void endgame_clear(tEndgame *pEndgame);
+bool endgame_active(tEndgame *pEndgame, tBoard *pBoard);
+int endgame_solve(tEndgame *pEndgame, tBoard *pBoard, tScore *pScore);
+
+#endif
@@ -0,0 +1,524 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "board.h"
+#include "book.h"
+#include "config.h"
+#include "debug.h"
+#include "endgame.h"
+#include "engine.h"
+#include "mctn.h"
+#include "mctnlist.h"
+#include "mcts.h"
+#include "rules.h"
+#include "ttt.h"
+#include "types.h"
+#include "util.h"
+
+#ifdef SPEED
+#include "scorer.h"
+#endif
+
+#define ENGINE_SEED_STEP    0x9E3779B97F4A7C15ULL
+
+struct Engine
+{
+    tTTT Game;
+    tConfig Config;
+    pthread_mutex_t Mutex;
+    atomic_bool Stop;
+    int BestMove;
+    double TimeMs;
+    uint32_t Searched;
+};
+
+static int engine_reset(tEngine *pEngine, eRulesType RulesType);
+static bool engine_continues(tEngine *pEngine, const int *pMoves, int Size);
+static int engine_compare_children(const void *pA, const void *pB);
+static double engine_time_ms(struct timespec *pBegin, struct timespec *pEnd);
+
+/*
+ * The scorer lookup is shared by every engine, so it is built by the first
+ * engine and freed with the last one. Seeding also goes through this lock, as
+ * random_init is not thread-safe and engines created in the same second would
+ * otherwise play the same games.
+ */
+static pthread_mutex_t EngineLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t EngineCount = 0;
+static uint64_t EngineSerial = 0;
+
+void engine_config_init(tEngineConfig *pConfig)
+{
+    tConfig Config;
+
+    config_init(&Config);
+    config_engine(&Config, pConfig);
+    config_free(&Config);
+
+    pConfig->pBookFile = NULL;
+}
+
+int engine_create(tEngine **ppEngine, const tEngineConfig *pConfig)
+{
+    int Res = 0;
+    tEngine *pEngine;
+
+    *ppEngine = NULL;
+
+    if (pConfig->RulesType < RULES_CLASSICAL OR pConfig->RulesType > RULES_MALLORCAN
+        OR pConfig->Simulations == 0 OR pConfig->Simulations > TVISITS_MAX
+        OR pConfig->Widening > ROWS*COLUMNS OR pConfig->EndgameEmptySquares > ROWS*COLUMNS
+        OR (pConfig->MemoryMode ISNOT MCTS_MEMORY_STOP AND pConfig->MemoryMode ISNOT MCTS_MEMORY_PRUNE)
+        OR pConfig->PriorExploration < 0.0f
+        OR (pConfig->pBookFile ISNOT NULL AND strlen(pConfig->pBookFile) >= BOOK_FILE_LEN))
+    {
+        Res = -EINVAL;
+        dbg_printf(DEBUG_LEVEL_ERROR, "Invalid engine configuration");
+        goto Error;
+    }
+
+    pEngine = emalloc(sizeof(tEngine));
+
+    Res = config_init(&pEngine->Config);
+    if (Res < 0)
+    {
+        goto FreeEngine;
+    }
+
+    pEngine->Config.RulesConfig.RulesType = pConfig->RulesType;
+    pEngine->Config.MctsConfig.Simulations = pConfig->Simulations;
+    pEngine->Config.MctsConfig.SearchOnlyNeighbors = pConfig->SearchOnlyNeighbors;
+    pEngine->Config.MctsConfig.RaveEquivalence = pConfig->RaveEquivalence;
+    pEngine->Config.MctsConfig.Widening = pConfig->Widening;
+    pEngine->Config.MctsConfig.MemoryBudget = pConfig->MemoryBudget;
+    pEngine->Config.MctsConfig.MemoryMode = pConfig->MemoryMode;
+    pEngine->Config.MctsConfig.BackgroundFree = pConfig->BackgroundFree;
+    pEngine->Config.MctsConfig.PriorExploration = pConfig->PriorExploration;
+    pEngine->Config.EndgameConfig.EmptySquares = pConfig->EndgameEmptySquares;
+
+    if (pConfig->pBookFile ISNOT NULL)
+    {
+        strcpy(pEngine->Config.BookConfig.File, pConfig->pBookFile);
+    }
+
+    pthread_mutex_lock(&EngineLock);
+
+#ifdef SPEED
+    if (EngineCount == 0)
+    {
+        scorer_init();
+    }
+#endif
+
+    Res = ttt_init(&pEngine->Game, &pEngine->Config);
+    if (Res < 0)
+    {
+#ifdef SPEED
+        if (EngineCount == 0)
+        {
+            scorer_free();
+        }
+#endif
+        pthread_mutex_unlock(&EngineLock);
+        goto FreeConfig;
+    }
+
+    pEngine->Game.Mcts.Random.s[0] += ++EngineSerial * ENGINE_SEED_STEP;
+    EngineCount++;
+
+    pthread_mutex_unlock(&EngineLock);
+
+    pthread_mutex_init(&pEngine->Mutex, NULL);
+    atomic_init(&pEngine->Stop, false);
+    pEngine->BestMove = -ENODATA;
+    pEngine->TimeMs = 0.0;
+    pEngine->Searched = 0;
+
+    *ppEngine = pEngine;
+
+    goto Success;
+
+FreeConfig:
+    config_free(&pEngine->Config);
+
+FreeEngine:
+    free(pEngine);
+
+Error:
+Success:
+    return Res;
+}
+
+void engine_free(tEngine *pEngine)
+{
+    ttt_free(&pEngine->Game);
+    config_free(&pEngine->Config);
+    pthread_mutex_destroy(&pEngine->Mutex);
+    free(pEngine);
+
+    pthread_mutex_lock(&EngineLock);
+
+#ifdef SPEED
+    if (EngineCount == 1)
+    {
+        scorer_free();
+    }
+#endif
+
+    EngineCount--;
+
+    pthread_mutex_unlock(&EngineLock);
+}
+
+/*
+ * When the current moves are a prefix of the new ones under the same rules,
+ * only the remaining moves are given, so the search tree is kept. Otherwise the
+ * game starts over. If a move is invalid, the engine is left at the start.
+ */
+int engine_set_position(tEngine *pEngine, int RulesType, const int *pMoves, int Size)
+{
+    int Res = 0, Move;
+
+    if (RulesType < RULES_CLASSICAL OR RulesType > RULES_MALLORCAN OR Size < 0 OR Size > ROWS*COLUMNS)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    pthread_mutex_lock(&pEngine->Mutex);
+
+    Move = board_move(&pEngine->Game.Board);
+
+    if (RulesType ISNOT pEngine->Config.RulesConfig.RulesType OR NOT engine_continues(pEngine, pMoves, Size))
+    {
+        Res = engine_reset(pEngine, RulesType);
+        if (Res < 0)
+        {
+            goto Unlock;
+        }
+
+        Move = 0;
+    }
+
+    for (int i = Move; i < Size; ++i)
+    {
+        Res = ttt_give_move(&pEngine->Game, pMoves[i]);
+        if (Res < 0)
+        {
+            engine_reset(pEngine, RulesType);
+            goto Unlock;
+        }
+    }
+
+    pEngine->BestMove = -ENODATA;
+
+Unlock:
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+Error:
+    return Res;
+}
+
+int engine_give_move(tEngine *pEngine, int Index)
+{
+    int Res;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+
+    Res = ttt_give_move(&pEngine->Game, Index);
+    if (Res == 0)
+    {
+        pEngine->BestMove = -ENODATA;
+    }
+
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    return Res;
+}
+
+/*
+ * A zero in the budget falls back to the configured simulations, or does not
+ * limit the time. As with the configuration, the simulations count the visits
+ * that the root kept from earlier searches.
+ */
+int engine_search(tEngine *pEngine, const tEngineBudget *pBudget)
+{
+    int Res;
+    struct timespec Begin, End;
+    tVisits Simulations = pEngine->Config.MctsConfig.Simulations, Start;
+    uint32_t TimeMs = 0;
+
+    if (pBudget ISNOT NULL)
+    {
+        Simulations = IF (pBudget->Simulations > 0) THEN pBudget->Simulations ELSE Simulations;
+        Simulations = IF (Simulations > TVISITS_MAX) THEN TVISITS_MAX ELSE Simulations;
+        TimeMs = pBudget->TimeMs;
+    }
+
+    pthread_mutex_lock(&pEngine->Mutex);
+
+    clock_gettime(CLOCK_MONOTONIC, &Begin);
+
+    Start = mctn_visits(pEngine->Game.Mcts.pRoot);
+    Res = ttt_search(&pEngine->Game, Simulations, TimeMs, &pEngine->Stop);
+
+    atomic_store(&pEngine->Stop, false);
+    clock_gettime(CLOCK_MONOTONIC, &End);
+
+    pEngine->TimeMs = engine_time_ms(&Begin, &End);
+    pEngine->Searched = mctn_visits(pEngine->Game.Mcts.pRoot) - Start;
+    pEngine->BestMove = Res;
+
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    return Res;
+}
+
+/*
+ * Stops the running search, or the next one if no search is running, since the
+ * request is only cleared when a search returns or by engine_clear_stop.
+ */
+void engine_stop(tEngine *pEngine)
+{
+    atomic_store(&pEngine->Stop, true);
+}
+
+void engine_clear_stop(tEngine *pEngine)
+{
+    atomic_store(&pEngine->Stop, false);
+}
+
+int engine_best_move(tEngine *pEngine)
+{
+    int Res;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+    Res = pEngine->BestMove;
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    return Res;
+}
+
+/*
+ * The node counts are kept up to date as the tree grows, so the statistics are
+ * cheap enough to poll during a game. The rate is that of the last search.
+ */
+void engine_stats(tEngine *pEngine, tEngineStats *pStats)
+{
+    tMctsStats Stats;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+
+    mcts_stats(&pEngine->Game.Mcts, &Stats);
+
+    pStats->Simulations = mctn_visits(pEngine->Game.Mcts.pRoot);
+    pStats->Nodes = Stats.Nodes;
+    pStats->TreeBytes = Stats.Bytes;
+    pStats->MaxDepth = Stats.MaxDepth;
+    pStats->Eval = mcts_evaluate(&pEngine->Game.Mcts);
+    pStats->Retained = mcts_retained(&pEngine->Game.Mcts);
+    pStats->TimeMs = pEngine->TimeMs;
+    pStats->SimulationsPerSec = IF (pEngine->TimeMs > 0.0) THEN pEngine->Searched * 1.0e3 / pEngine->TimeMs ELSE 0.0;
+
+    pthread_mutex_unlock(&pEngine->Mutex);
+}
+
+/*
+ * Copies up to Capacity of the root's children, most visited first, and returns
+ * how many there are. A child's score is its mean result for the player to move,
+ * and its nodes are the size of its subtree.
+ * Positions that the endgame solver decides have none, as the tree is not used.
+ */
+int engine_children(tEngine *pEngine, tEngineChild *pChildren, int Capacity)
+{
+    tEngineChild Children[ROWS*COLUMNS];
+    tMctn *pRoot;
+    int Size;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+
+    pRoot = pEngine->Game.Mcts.pRoot;
+    Size = IF (endgame_active(&pEngine->Game.Endgame, &pEngine->Game.Board)) THEN 0
+        ELSE mctnlist_size(&pRoot->Children);
+
+    for (int i = 0; i < Size; ++i)
+    {
+        tMctn *pChild = mctnlist_get(&pRoot->Children, i);
+        tVisits Visits = mctn_visits(pChild);
+
+        Children[i].Index = board_last_move_index(&pChild->State);
+        Children[i].Visits = Visits;
+        Children[i].Score = IF (Visits > 0) THEN pChild->Score / Visits ELSE 0.0f;
+        Children[i].Nodes = mcts_branch_nodes(&pEngine->Game.Mcts, Children[i].Index);
+    }
+
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    qsort(Children, Size, sizeof(tEngineChild), engine_compare_children);
+
+    for (int i = 0; i < Size AND i < Capacity; ++i)
+    {
+        pChildren[i] = Children[i];
+    }
+
+    return Size;
+}
+
+/*
+ * Copies up to Capacity moves and returns how many moves have been made.
+ */
+int engine_moves(tEngine *pEngine, int *pMoves, int Capacity)
+{
+    int Size;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+
+    Size = board_move(&pEngine->Game.Board);
+
+    for (int i = 0; i < Size AND i < Capacity; ++i)
+    {
+        pMoves[i] = pEngine->Game.Moves[i];
+    }
+
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    return Size;
+}
+
+bool engine_player(tEngine *pEngine)
+{
+    bool Player;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+    Player = ttt_get_player(&pEngine->Game);
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    return Player;
+}
+
+bool engine_finished(tEngine *pEngine)
+{
+    bool Finished;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+    Finished = ttt_finished(&pEngine->Game);
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    return Finished;
+}
+
+int engine_score(tEngine *pEngine)
+{
+    int Score;
+
+    pthread_mutex_lock(&pEngine->Mutex);
+    Score = ttt_get_score(&pEngine->Game);
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    return Score;
+}
+
+/*
+ * Writes the search tree to a file, leaving out the levels below Depth (0 keeps
+ * them all) and the children of nodes with fewer than MinVisits visits.
+ */
+int engine_save_tree(tEngine *pEngine, const char *pFile, uint32_t Depth, uint32_t MinVisits)
+{
+    int Res = 0;
+    FILE *pOut;
+
+    if (Depth > ROWS*COLUMNS)
+    {
+        Depth = 0;
+    }
+
+    pOut = fopen(pFile, "wb");
+    if (pOut IS NULL)
+    {
+        Res = -errno;
+        goto Error;
+    }
+
+    pthread_mutex_lock(&pEngine->Mutex);
+    Res = mcts_save(&pEngine->Game.Mcts, pOut, Depth, MinVisits);
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    if (fclose(pOut) ISNOT 0 AND Res == 0)
+    {
+        Res = -errno;
+    }
+
+Error:
+    return Res;
+}
+
+/*
+ * Replaces the search tree with one saved by engine_save_tree for the current
+ * position, so that the next search continues from it. Fails with -ESRCH if
+ * the tree was saved for another position or ruleset.
+ */
+int engine_load_tree(tEngine *pEngine, const char *pFile)
+{
+    int Res = 0;
+    FILE *pIn;
+
+    pIn = fopen(pFile, "rb");
+    if (pIn IS NULL)
+    {
+        Res = -errno;
+        goto Error;
+    }
+
+    pthread_mutex_lock(&pEngine->Mutex);
+
+    Res = mcts_load(&pEngine->Game.Mcts, pIn);
+    if (Res == 0)
+    {
+        pEngine->BestMove = -ENODATA;
+    }
+
+    pthread_mutex_unlock(&pEngine->Mutex);
+
+    fclose(pIn);
+
+Error:
+    return Res;
+}
+
+static int engine_reset(tEngine *pEngine, eRulesType RulesType)
+{
+    pEngine->Config.RulesConfig.RulesType = RulesType;
+
+    return ttt_reset(&pEngine->Game, &pEngine->Config);
+}
+
+static bool engine_continues(tEngine *pEngine, const int *pMoves, int Size)
+{
+    bool Continues = Size >= board_move(&pEngine->Game.Board);
+
+    for (int i = 0; Continues AND i < board_move(&pEngine->Game.Board); ++i)
+    {
+        Continues = pMoves[i] == pEngine->Game.Moves[i];
+    }
+
+    return Continues;
+}
+
+static int engine_compare_children(const void *pA, const void *pB)
+{
+    const tEngineChild *pChildA = pA, *pChildB = pB;
+
+    return (pChildA->Visits < pChildB->Visits) - (pChildA->Visits > pChildB->Visits);
+}
+
+static double engine_time_ms(struct timespec *pBegin, struct timespec *pEnd)
+{
+    return (pEnd->tv_sec * 1.0e3 + pEnd->tv_nsec / 1.0e6) - (pBegin->tv_sec * 1.0e3 + pBegin->tv_nsec / 1.0e6);
+}
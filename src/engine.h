@@ -0,0 +1,87 @@
+#ifndef __ENGINE_H__
+#define __ENGINE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define ENGINE_API __attribute__((visibility("default")))
+#else
+#define ENGINE_API
+#endif
+
+/*
+ * The engine is opaque and owns its search tree, which grows as it searches and
+ * is released by engine_free. Every other input and output is a caller-owned
+ * buffer. Separate engines may be used from separate threads, and calls on the
+ * same engine are serialized, except engine_stop, which may interrupt a search
+ * running on another thread. A stop that arrives before a search starts ends
+ * that search as soon as it begins, unless engine_clear_stop withdraws it.
+ */
+typedef struct Engine tEngine;
+
+typedef struct EngineConfig
+{
+    int RulesType;
+    uint32_t Simulations;
+    bool SearchOnlyNeighbors;
+    uint32_t RaveEquivalence;
+    uint32_t Widening;
+    size_t MemoryBudget;
+    int MemoryMode;
+    bool BackgroundFree;
+    float PriorExploration;
+    uint32_t EndgameEmptySquares;
+    const char *pBookFile;
+}
+tEngineConfig;
+
+typedef struct EngineBudget
+{
+    uint32_t Simulations;
+    uint32_t TimeMs;
+}
+tEngineBudget;
+
+typedef struct EngineChild
+{
+    int Index;
+    uint32_t Visits;
+    float Score;
+    uint32_t Nodes;
+}
+tEngineChild;
+
+typedef struct EngineStats
+{
+    uint32_t Simulations;
+    uint32_t Nodes;
+    size_t TreeBytes;
+    uint32_t MaxDepth;
+    float Eval;
+    float Retained;
+    double TimeMs;
+    double SimulationsPerSec;
+}
+tEngineStats;
+
+ENGINE_API void engine_config_init(tEngineConfig *pConfig);
+ENGINE_API int engine_create(tEngine **ppEngine, const tEngineConfig *pConfig);
+ENGINE_API void engine_free(tEngine *pEngine);
+ENGINE_API int engine_set_position(tEngine *pEngine, int RulesType, const int *pMoves, int Size);
+ENGINE_API int engine_give_move(tEngine *pEngine, int Index);
+ENGINE_API int engine_search(tEngine *pEngine, const tEngineBudget *pBudget);
+ENGINE_API void engine_stop(tEngine *pEngine);
+ENGINE_API void engine_clear_stop(tEngine *pEngine);
+ENGINE_API int engine_best_move(tEngine *pEngine);
+ENGINE_API void engine_stats(tEngine *pEngine, tEngineStats *pStats);
+ENGINE_API int engine_children(tEngine *pEngine, tEngineChild *pChildren, int Capacity);
+ENGINE_API int engine_moves(tEngine *pEngine, int *pMoves, int Capacity);
+ENGINE_API bool engine_player(tEngine *pEngine);
+ENGINE_API bool engine_finished(tEngine *pEngine);
+ENGINE_API int engine_score(tEngine *pEngine);
+ENGINE_API int engine_save_tree(tEngine *pEngine, const char *pFile, uint32_t Depth, uint32_t MinVisits);
+ENGINE_API int engine_load_tree(tEngine *pEngine, const char *pFile);
+
+#endif
@@ -0,0 +1,181 @@
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitutil.h"
+#include "board.h"
+#include "config.h"
+#include "debug.h"
+#include "engine.h"
+#include "mctn.h"
+#include "mcts.h"
+#include "protocol.h"
+#include "rules.h"
+#include "ttt.h"
+#include "util.h"
+
+#ifdef SPEED
+#include "scorer.h"
+#endif
+
+#define MAIN_HEADLESS   "--headless"
+
+static int main_get_player_move(tTTT *pGame, bool ComputerPlaying);
+
+int main(int argc, char **argv)
+{
+    int Res = 0;
+
+    tTTT Game;
+    tConfig Config;
+    
+    Res = config_init(&Config);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
+    Res = config_load(&Config);
+    if (Res < 0)
+    {
+        goto FreeConfig;
+    }
+
+    if (argc > 1 AND strcmp(argv[1], MAIN_HEADLESS) == 0)
+    {
+        tEngineConfig EngineConfig;
+
+        config_engine(&Config, &EngineConfig);
+
+        Res = protocol_run(stdin, stdout, &EngineConfig);
+
+        goto FreeConfig;
+    }
+
+    Res = ttt_init(&Game, &Config);
+    if (Res < 0)
+    {
+        goto FreeConfig;
+    }
+
+#ifdef SPEED
+    scorer_init();
+#endif
+
+    char BoardStr[BOARD_STR_LEN], MovesStr[RULES_MOVES_STR_LEN];
+#ifdef STATS
+    char MctsStr[MCTS_STR_LEN];
+#endif
+    int Moves[ROWS*COLUMNS];
+    int MovesSize;
+
+    board_string_to_buf(&Game.Board, BoardStr, sizeof(BoardStr));
+    printf("%s\n\n", BoardStr);
+
+    while (NOT board_finished(&Game.Board))
+    {
+        int Index;
+        bool Player = ttt_get_player(&Game);
+
+        Res = IF (Config.ComputerPlaying AND Player == Config.ComputerPlayer)
+            THEN ttt_get_ai_move(&Game)
+            ELSE main_get_player_move(&Game, Config.ComputerPlaying);
+
+        if (Res < 0)
+        {
+            dbg_printf(DEBUG_LEVEL_ERROR, "Failed to get move");
+            goto FreeGame;
+        }
+
+        Index = Res;
+
+#ifdef STATS
+        if (Config.ComputerPlaying AND mctn_visits(Game.Mcts.pRoot) > 0)
+        {
+            mcts_string_to_buf(&Game.Mcts, MctsStr, sizeof(MctsStr));
+            printf("BEFORE SHIFT\n%s\n", MctsStr);
+
+            float Eval = mcts_evaluate(&Game.Mcts);
+            if (Eval > -FLT_MAX) printf("Eval: %.2f\n\n", Eval);
+        }
+#endif
+
+        ttt_give_move(&Game, Index);
+
+#ifdef STATS
+        if (Config.ComputerPlaying AND mctn_visits(Game.Mcts.pRoot) > 0)
+        {
+            mcts_string_to_buf(&Game.Mcts, MctsStr, sizeof(MctsStr));
+            printf("AFTER SHIFT\n%s\n", MctsStr);
+            printf("Retained: %.2f%%\n", 100.0f * mcts_retained(&Game.Mcts));
+
+            float Eval = mcts_evaluate(&Game.Mcts);
+            if (Eval > -FLT_MAX) printf("Eval: %.2f\n\n", Eval);
+        }
+#endif
+
+        MovesSize = ttt_get_moves_to_buf(&Game, Moves, ROWS*COLUMNS);
+        rules_moves_string_to_buf(&Game.Rules, Moves, MovesSize, MovesStr, sizeof(MovesStr));
+        board_string_to_buf(&Game.Board, BoardStr, sizeof(BoardStr));
+
+        printf("%s\n", MovesStr);
+        printf("%s\n\n", BoardStr);
+    }
+
+    int Score = ttt_get_score(&Game);
+    printf("Score: %d\n", Score);
+
+#ifdef SPEED
+    scorer_free();
+#endif
+
+FreeGame:
+    ttt_free(&Game);
+
+FreeConfig:
+    config_free(&Config);
+
+Error:
+    return Res;
+}
+
+static int main_get_player_move(tTTT *pGame, bool ComputerPlaying)
+{
+    int Index;
+    bool Player = ttt_get_player(pGame);
+    uint64_t Indices = rules_indices(&pGame->Rules, &pGame->Board, false);
+    char Id[BOARD_ID_STR_LEN];
+
+    while (true)
+    {
+        if (ComputerPlaying)
+        {
+            printf("Enter move: ");
+        }
+        else
+        {
+            printf("Enter move (Player %d): ", (Player ? 1 : 2));
+        }
+
+        if (fgets(Id, sizeof(Id), stdin) ISNOT NULL)
+        {
+            int c; 
+            while ((c = getchar()) != '\n' AND c != EOF);
+
+            if (board_id_valid(&Id))
+            {
+                Index = board_id_index(&Id);
+
+                if (BitTest64(Indices, Index))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    return Index;
+}
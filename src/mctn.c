@@ -4,27 +4,35 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "bitutil.h"
 #include "board.h"
 #include "mctn.h"
 #include "mctnlist.h"
 #include "types.h"
 #include "util.h"
 
-static uint32_t mctn_size(tMctn *pNode);
-static float uct(tVisits ParentVisits, tVisits Visits, float Score);
+static float uct_rave(tVisits ParentVisits, tMctn *pNode, uint32_t RaveEquivalence);
+static float rave_value(tMctn *pNode, uint32_t RaveEquivalence);
 
 void mctn_init(tMctn *pNode, tBoard *pBoard)
 {
     board_copy(&pNode->State, pBoard);
     mctnlist_init(&pNode->Children);
 
-    pNode->Visits = 0;
+    pNode->Unexpanded = 0ULL;
+    pNode->VisitsLow = 0;
+    pNode->AmafVisitsLow = 0;
     pNode->Score = 0.0f;
+    pNode->AmafScore = 0.0f;
+    pNode->Proof = MCTN_PROOF_NONE;
+    pNode->VisitsHigh = 0;
+    pNode->AmafVisitsHigh = 0;
+    pNode->Prior = 0;
 }
 
-void mctn_free(tMctn *pNode)
+uint32_t mctn_free(tMctn *pNode)
 {
-    mctnlist_free(&pNode->Children);
+    return mctnlist_free(&pNode->Children);
 }
 
 void mctn_copy(tMctn *pNode, tMctn *pN)
@@ -32,10 +40,59 @@ void mctn_copy(tMctn *pNode, tMctn *pN)
     *pNode = *pN;
 }
 
+/*
+ * Visit counters are 24 bits wide, split into 16 and 8 bits so that they pack
+ * with the other small fields in front of the scores. The scores are summed in
+ * double precision, as a float sum stops counting every visit long before the
+ * counters saturate.
+ */
 void mctn_update(tMctn *pNode, float Score)
 {
+    tVisits Visits = mctn_visits(pNode);
+
+    if (Visits < TVISITS_MAX)
+    {
+        Visits++;
+        pNode->VisitsLow = Visits & UINT16_MAX;
+        pNode->VisitsHigh = Visits >> 16;
+    }
+
     pNode->Score += Score;
-    pNode->Visits++;
+}
+
+void mctn_update_amaf(tMctn *pNode, float Score)
+{
+    tVisits Visits = mctn_amaf_visits(pNode);
+
+    if (Visits < TVISITS_MAX)
+    {
+        Visits++;
+        pNode->AmafVisitsLow = Visits & UINT16_MAX;
+        pNode->AmafVisitsHigh = Visits >> 16;
+    }
+
+    pNode->AmafScore += Score;
+}
+
+tVisits mctn_visits(tMctn *pNode)
+{
+    return (tVisits) pNode->VisitsHigh << 16 | pNode->VisitsLow;
+}
+
+tVisits mctn_amaf_visits(tMctn *pNode)
+{
+    return (tVisits) pNode->AmafVisitsHigh << 16 | pNode->AmafVisitsLow;
+}
+
+void mctn_set_visits(tMctn *pNode, tVisits Visits, tVisits AmafVisits)
+{
+    Visits = IF (Visits > TVISITS_MAX) THEN TVISITS_MAX ELSE Visits;
+    AmafVisits = IF (AmafVisits > TVISITS_MAX) THEN TVISITS_MAX ELSE AmafVisits;
+
+    pNode->VisitsLow = Visits & UINT16_MAX;
+    pNode->VisitsHigh = Visits >> 16;
+    pNode->AmafVisitsLow = AmafVisits & UINT16_MAX;
+    pNode->AmafVisitsHigh = AmafVisits >> 16;
 }
 
 void mctn_expand(tMctn *pNode, tBoard *pStates, tSize Size)
@@ -43,6 +100,13 @@ void mctn_expand(tMctn *pNode, tBoard *pStates, tSize Size)
     mctnlist_expand(&pNode->Children, pStates, Size);
 }
 
+tMctn *mctn_add_child(tMctn *pNode, tBoard *pState)
+{
+    tSize Capacity = mctnlist_size(&pNode->Children) + 1 + BitPopCount64(pNode->Unexpanded);
+
+    return mctnlist_add(&pNode->Children, pState, Capacity);
+}
+
 bool mctn_equals(tMctn *pNode, tMctn *pN)
 {
     return board_equals(&pNode->State, &pN->State);
@@ -69,7 +133,7 @@ tMctn *mctn_most_visited_child(tMctn *pNode)
     for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
     {
         pChild = mctnlist_get(&pNode->Children, i);
-        Visits = pChild->Visits;
+        Visits = mctn_visits(pChild);
 
         SET_IF_GREATER_EQ_W_EXTRA(Visits, MaxVisits, pChild, pWinner);
     }
@@ -77,59 +141,131 @@ tMctn *mctn_most_visited_child(tMctn *pNode)
     return pWinner;
 }
 
-tMctn *mctn_best_child_uct(tMctn *pNode)
+/*
+ * A proven win is always chosen and a proven loss only when every child is a
+ * proven loss, otherwise the most visited child is chosen.
+ */
+tMctn *mctn_best_child(tMctn *pNode)
 {
     tMctn *pChild, *pWinner = NULL;
-    float Uct, MaxUct = -FLT_MAX;
+    tVisits Visits, MaxVisits = 0;
+    int Rank, MaxRank = -1;
 
     for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
     {
         pChild = mctnlist_get(&pNode->Children, i);
-        Uct = uct(pNode->Visits, pChild->Visits, pChild->Score);
+        Visits = mctn_visits(pChild);
+        Rank = IF (pChild->Proof == MCTN_PROOF_WIN) THEN 2
+            ELSE IF (pChild->Proof == MCTN_PROOF_LOSS) THEN 0
+            ELSE 1;
 
-        SET_IF_GREATER_EQ_W_EXTRA(Uct, MaxUct, pChild, pWinner);
+        if (Rank > MaxRank OR (Rank == MaxRank AND Visits >= MaxVisits))
+        {
+            pWinner = pChild;
+            MaxRank = Rank;
+            MaxVisits = Visits;
+        }
     }
 
     return pWinner;
 }
 
-char *mctn_string(tMctn *pNode)
+/*
+ * Proven children are skipped, unless every child is proven, which can happen
+ * when the children do not cover every legal move. With PUCT, unvisited
+ * children are valued at the first play urgency instead of being tried first.
+ */
+tMctn *mctn_best_child_uct(tMctn *pNode, uint32_t RaveEquivalence, const tMctnPuct *pPuct, float *pValue)
 {
-    char *Str = emalloc(MCTN_STR_LEN * sizeof(char)), *pBegin = Str, *pId = NULL;
-    tVisits Visits = pNode->Visits;
-
-    Str += sprintf(Str, "Tree size: %d, Root score: %.2f/%d\n", mctn_size(pNode), pNode->Score, Visits);
+    tMctn *pChild, *pWinner = NULL;
+    float Uct, MaxUct = -FLT_MAX;
+    tVisits Visits = mctn_visits(pNode);
 
-    for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
+    for (int Pass = 0; Pass < 2 AND pWinner IS NULL; ++Pass)
     {
-        tMctn *pChild = mctnlist_get(&pNode->Children, i);
-        pId = board_index_id(board_last_move_index(&pChild->State));
+        for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
+        {
+            pChild = mctnlist_get(&pNode->Children, i);
+
+            if (Pass == 0 AND pChild->Proof ISNOT MCTN_PROOF_NONE)
+            {
+                continue;
+            }
+
+            if (pPuct ISNOT NULL)
+            {
+                tVisits ChildVisits = mctn_visits(pChild);
+                float Value = IF (ChildVisits == 0) THEN pPuct->Fpu ELSE rave_value(pChild, RaveEquivalence);
 
-        float Eval = IF (pChild->Visits > 0) THEN pChild->Score/pChild->Visits ELSE 0.0f;
-        
-        Str += sprintf(Str, "%s: %0.2f @ %.2f/%d ** %d Nodes ** %3.3e UCT\n", 
-            pId, Eval, pChild->Score, pChild->Visits, mctn_size(pChild), 
-            uct(Visits, pChild->Visits, pChild->Score));
+                Uct = mctn_puct(pPuct, Visits, ChildVisits, Value, pChild->Prior);
+            }
+            else
+            {
+                Uct = IF (RaveEquivalence > 0) THEN uct_rave(Visits, pChild, RaveEquivalence) 
+                    ELSE mctn_uct(Visits, mctn_visits(pChild), pChild->Score);
+            }
 
-        free(pId);
+            SET_IF_GREATER_EQ_W_EXTRA(Uct, MaxUct, pChild, pWinner);
+        }
     }
 
-    return pBegin;
+    if (pValue ISNOT NULL)
+    {
+        *pValue = MaxUct;
+    }
+
+    return pWinner;
 }
 
-static uint32_t mctn_size(tMctn *pNode)
+/*
+ * The exploration term is weighted by the move's share of the prior, so the
+ * search settles on the moves the heuristic likes before it has tried the rest.
+ */
+float mctn_puct(const tMctnPuct *pPuct, tVisits ParentVisits, tVisits Visits, float Value, uint8_t Prior)
 {
-    uint32_t Size = 1;
+    return Value + pPuct->Exploration * (Prior / pPuct->PriorSum) * sqrtf(ParentVisits) / (1 + Visits);
+}
 
-    for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
+float mctn_uct(tVisits ParentVisits, tVisits Visits, double Score)
+{
+    return IF (Visits == 0) THEN FLT_MAX ELSE (float) (Score/Visits) + sqrtf(2*logf(ParentVisits)/Visits);
+}
+
+/*
+ * The value of a node is blended with its all-moves-as-first value using the
+ * schedule sqrt(k/(3n+k)), so the AMAF value dominates while the node has few
+ * visits and fades out as its own visits approach the equivalence parameter k.
+ */
+static float uct_rave(tVisits ParentVisits, tMctn *pNode, uint32_t RaveEquivalence)
+{
+    float Uct;
+    tVisits NodeVisits = mctn_visits(pNode);
+
+    if (mctn_amaf_visits(pNode) == 0)
     {
-        Size += mctn_size(mctnlist_get(&pNode->Children, i));
+        Uct = mctn_uct(ParentVisits, NodeVisits, pNode->Score);
     }
+    else
+    {
+        float Visits = IF (NodeVisits > 0) THEN NodeVisits ELSE 1.0f;
 
-    return Size;
+        Uct = rave_value(pNode, RaveEquivalence) + sqrtf(2*logf(ParentVisits)/Visits);
+    }
+
+    return Uct;
 }
 
-static float uct(tVisits ParentVisits, tVisits Visits, float Score)
+static float rave_value(tMctn *pNode, uint32_t RaveEquivalence)
 {
-    return IF (Visits == 0) THEN FLT_MAX ELSE (Score/Visits) + sqrtf(2*logf(ParentVisits)/Visits);
+    tVisits NodeVisits = mctn_visits(pNode), AmafVisits = mctn_amaf_visits(pNode);
+    float Value = IF (NodeVisits > 0) THEN pNode->Score/NodeVisits ELSE 0.0f;
+
+    if (RaveEquivalence > 0 AND AmafVisits > 0)
+    {
+        float Beta = sqrtf(RaveEquivalence / (3.0f*NodeVisits + RaveEquivalence));
+
+        Value = (1.0f - Beta) * Value + Beta * (pNode->AmafScore/AmafVisits);
+    }
+
+    return Value;
 }
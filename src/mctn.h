@@ -8,15 +8,26 @@
 #include "mctnlist.h"
 #include "random.h"
 
-#define MCTN_STR_LEN    2048
+#define TVISITS_MAX     ((1UL << 24) - 1)
 
-#ifdef VISITS32
-#define TVISITS_MAX     1e6
 typedef uint32_t tVisits;
-#else
-#define TVISITS_MAX     UINT16_MAX
-typedef uint16_t tVisits;
-#endif
+
+typedef enum MctnProof
+{
+    MCTN_PROOF_NONE = 0,
+    MCTN_PROOF_LOSS = 1,
+    MCTN_PROOF_DRAW = 2,
+    MCTN_PROOF_WIN  = 3,
+}
+eMctnProof;
+
+typedef struct MctnPuct
+{
+    float Exploration;
+    float PriorSum;
+    float Fpu;
+}
+tMctnPuct;
 
 typedef struct
 #ifdef PACKED
@@ -26,20 +37,34 @@ Mctn
 {
     tBoard State;
     tMctnList Children;
-    tVisits Visits;
-    float Score;
+    uint64_t Unexpanded;
+    uint16_t VisitsLow;
+    uint16_t AmafVisitsLow;
+    uint8_t Proof;
+    uint8_t VisitsHigh;
+    uint8_t AmafVisitsHigh;
+    uint8_t Prior;
+    double Score;
+    double AmafScore;
 } 
 tMctn;
 
 void mctn_init(tMctn *pNode, tBoard *pBoard);
-void mctn_free(tMctn *pNode);
+uint32_t mctn_free(tMctn *pNode);
 void mctn_copy(tMctn *pNode, tMctn *pN);
 void mctn_update(tMctn *pNode, float Score);
+void mctn_update_amaf(tMctn *pNode, float Score);
+tVisits mctn_visits(tMctn *pNode);
+tVisits mctn_amaf_visits(tMctn *pNode);
+void mctn_set_visits(tMctn *pNode, tVisits Visits, tVisits AmafVisits);
 void mctn_expand(tMctn *pNode, tBoard *pStates, tSize Size);
+tMctn *mctn_add_child(tMctn *pNode, tBoard *pState);
 bool mctn_equals(tMctn *pNode, tMctn *pN);
 tMctn *mctn_random_child(tMctn *pNode, tRandom *pRandom);
 tMctn *mctn_most_visited_child(tMctn *pNode);
-tMctn *mctn_best_child_uct(tMctn *pNode);
-char *mctn_string(tMctn *pNode);
+tMctn *mctn_best_child(tMctn *pNode);
+tMctn *mctn_best_child_uct(tMctn *pNode, uint32_t RaveEquivalence, const tMctnPuct *pPuct, float *pValue);
+float mctn_puct(const tMctnPuct *pPuct, tVisits ParentVisits, tVisits Visits, float Value, uint8_t Prior);
+float mctn_uct(tVisits ParentVisits, tVisits Visits, double Score);
 
 #endif
@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "board.h"
@@ -12,16 +13,21 @@ void mctnlist_init(tMctnList *pList)
 {
     pList->pItems = NULL;
     pList->Size = 0;
+    pList->Capacity = 0;
 }
 
-void mctnlist_free(tMctnList *pList)
+uint32_t mctnlist_free(tMctnList *pList)
 {
+    uint32_t Count = pList->Size;
+
     for (tIndex i = 0; i < pList->Size; ++i)
     {
-        mctn_free(&pList->pItems[i]);
+        Count += mctn_free(&pList->pItems[i]);
     }
 
     free(pList->pItems);
+
+    return Count;
 }
 
 tSize mctnlist_size(tMctnList *pList)
@@ -38,6 +44,7 @@ void mctnlist_expand(tMctnList *pList, tBoard *pStates, tSize Size)
 {
     pList->pItems = emalloc(Size * sizeof(tMctn));
     pList->Size = Size;
+    pList->Capacity = Size;
 
     for (tIndex i = 0; i < Size; ++i)
     {
@@ -45,6 +52,23 @@ void mctnlist_expand(tMctnList *pList, tBoard *pStates, tSize Size)
     }
 }
 
+/*
+ * Capacity is the number of children the list is expected to end up with, so
+ * that a node widened one child at a time allocates once. The list still grows
+ * geometrically past it.
+ */
+tMctn *mctnlist_add(tMctnList *pList, tBoard *pState, tSize Capacity)
+{
+    if (pList->Size == pList->Capacity)
+    {
+        pList->Capacity = IF (Capacity > pList->Size) THEN Capacity ELSE 2*pList->Size + 1;
+        pList->pItems = erealloc(pList->pItems, pList->Capacity * sizeof(tMctn));
+    }
+
+    mctn_init(&pList->pItems[pList->Size], pState);
+
+    return &pList->pItems[pList->Size++];
+}
 
 tMctn *mctnlist_get(tMctnList *pList, tIndex Index)
 {
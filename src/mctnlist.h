@@ -2,6 +2,7 @@
 #define __MCTNLIST_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "board.h"
 #include "random.h"
@@ -17,14 +18,16 @@ MctnList
 {
     tMctn *pItems;
     tSize Size;
+    tSize Capacity;
 }
 tMctnList;
 
 void mctnlist_init(tMctnList *pList);
-void mctnlist_free(tMctnList *pList);
+uint32_t mctnlist_free(tMctnList *pList);
 tSize mctnlist_size(tMctnList *pList);
 bool mctnlist_empty(tMctnList *pList);
 void mctnlist_expand(tMctnList *pList, tBoard *pStates, tSize Size);
+tMctn *mctnlist_add(tMctnList *pList, tBoard *pState, tSize Capacity);
 tMctn *mctnlist_get(tMctnList *pList, tIndex Index);
 tMctn mctnlist_delete(tMctnList *pList, tMctn Node);
 tMctn mctnlist_set(tMctnList *pList, tIndex Index, tMctn Node);
@@ -1,19 +1,21 @@
 #include <errno.h>
 #include <float.h>
+#include <math.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-
-#ifdef TIMED
+#include <string.h>
 #include <time.h>
-#endif
 
+#include "bitutil.h"
 #include "board.h"
 #include "debug.h"
 #include "mctn.h"
 #include "mctnlist.h"
 #include "mcts.h"
 #include "random.h"
+#include "reclaimer.h"
 #include "rules.h"
 #include "types.h"
 #include "util.h"
@@ -27,14 +29,64 @@
 #define BOARD_LOSS_BASE     0.10f
 #define BOARD_LOSS_PENALTY  0.025f
 
+#define MCTS_RECLAIM_NODES  64
+#define MCTS_CLOCK_INTERVAL 64
+
+#define MCTS_PRIOR_CENTER   3
+
+#define MCTS_TREE_MAGIC     "TTTR"
+#define MCTS_TREE_VERSION   2
+#define MCTS_TREE_NO_INDEX  (ROWS*COLUMNS)
+#define MCTS_HASH_RULES     0x9E3779B97F4A7C15ULL
+
+typedef struct __attribute__((packed)) MctsTreeHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint64_t Rules;
+    uint64_t Data;
+    uint64_t Empty;
+}
+tMctsTreeHeader;
+
+typedef struct __attribute__((packed)) MctsTreeNode
+{
+    uint64_t Unexpanded;
+    uint32_t Visits;
+    uint32_t AmafVisits;
+    double Score;
+    double AmafScore;
+    uint8_t Index;
+    uint8_t Children;
+    uint8_t Proof;
+    uint8_t Prior;
+}
+tMctsTreeNode;
+
 static void mcts_expand_node(tMcts *pMcts, tMctn *pNode);
-static float mcts_simulation(tMcts *pMcts, tMctn *pNode);
-static float mcts_simulate_playout(tMcts *pMcts, tBoard *pState);
-static float mcts_weight_score(tScore Score);
+static void mcts_widen_node(tMcts *pMcts, tMctn *pNode);
+static tMctn *mcts_add_child(tMcts *pMcts, tMctn *pNode, tIndex Index);
+static tIndex mcts_prior_index(tMcts *pMcts, tBoard *pState, uint64_t Indices, bool Player, float *pPriorSum);
+static tMctn *mcts_select_puct(tMcts *pMcts, tMctn *pNode, bool CanExpand);
+static float mcts_simulation(tMcts *pMcts, tMctn *pNode, tBoard *pFinal);
+static float mcts_simulate_unexpanded(tMcts *pMcts, tMctn *pNode, tBoard *pFinal);
+static float mcts_simulate_playout(tMcts *pMcts, tBoard *pState, tBoard *pFinal);
+static void mcts_update_amaf(tMcts *pMcts, tMctn *pNode, tBoard *pFinal, float Res);
+static void mcts_prove_node(tMcts *pMcts, tMctn *pNode);
+static bool mcts_tree_full(tMcts *pMcts);
+static void mcts_prune_tree(tMcts *pMcts);
+static void mcts_count_child(tMcts *pMcts, tMctn *pChild);
+static void mcts_count_tree(tMcts *pMcts);
+static int mcts_save_node(FILE *pFile, tMctn *pNode, tSize Depth, tVisits MinVisits);
+static int mcts_load_node(tMcts *pMcts, FILE *pFile, tMctn *pNode, tMctsTreeNode *pRecord, uint32_t *pNodes);
+static int mcts_read_node(tMcts *pMcts, FILE *pFile, tBoard *pState, tMctsTreeNode *pRecord);
 
-#ifdef TIMED
+static uint8_t mcts_prior(tBoard *pState, tIndex Index, bool Player);
+static uint32_t mcts_prune_node(tMctn *pNode, uint32_t Threshold);
+static void mcts_count_node(tMctn *pNode, tSize Depth, tMctsBranch *pBranch);
+static float mcts_weight_score(tScore Score);
+static uint64_t mcts_rules_hash(tRules *pRules);
 static double time_diff_ms(struct timespec *pBegin, struct timespec *pEnd);
-#endif
 
 void mcts_init(tMcts *pMcts, tRules *pRules, tBoard *pState, tMctsConfig *pConfig)
 {
@@ -43,6 +95,13 @@ void mcts_init(tMcts *pMcts, tRules *pRules, tBoard *pState, tMctsConfig *pConfi
     pMcts->Player = rules_player(pRules, pState);
     pMcts->Config = *pConfig;
 
+    pMcts->Nodes = 1;
+    memset(pMcts->Branches, 0, sizeof(pMcts->Branches));
+    pMcts->Branch = 0;
+    pMcts->Counted = true;
+    pMcts->pReclaimer = reclaimer_create(pConfig->BackgroundFree);
+    pMcts->Retained = 0.0f;
+
     mctn_init(pMcts->pRoot, pState);
     random_init(&pMcts->Random);
 }
@@ -51,32 +110,88 @@ void mcts_config_init(tMctsConfig *pConfig)
 {
     pConfig->Simulations = 1000;
     pConfig->SearchOnlyNeighbors = true;
+    pConfig->RaveEquivalence = 0;
+    pConfig->Widening = 0;
+    pConfig->MemoryBudget = 0;
+    pConfig->MemoryMode = MCTS_MEMORY_STOP;
+    pConfig->BackgroundFree = false;
+    pConfig->PriorExploration = 0.0f;
 }
 
 void mcts_free(tMcts *pMcts)
 {
-    mctn_free(pMcts->pRoot);
+    reclaimer_discard(pMcts->pReclaimer, &pMcts->pRoot->Children);
+    reclaimer_destroy(pMcts->pReclaimer);
     free(pMcts->pRoot);
 }
 
+/*
+ * Starts over from pState, which may be under new rules, keeping the root, the
+ * reclaimer, and the random state. The old tree is left to the reclaimer and
+ * stays in the node count until it is freed.
+ */
+void mcts_reset(tMcts *pMcts, tBoard *pState)
+{
+    reclaimer_discard(pMcts->pReclaimer, &pMcts->pRoot->Children);
+
+    pMcts->Player = rules_player(pMcts->pRules, pState);
+    memset(pMcts->Branches, 0, sizeof(pMcts->Branches));
+    pMcts->Branch = 0;
+    pMcts->Counted = true;
+    pMcts->Retained = 0.0f;
+
+    mctn_init(pMcts->pRoot, pState);
+}
+
 void mcts_simulate(tMcts *pMcts)
 {
-    tVisits Count = pMcts->pRoot->Visits, Simulations = pMcts->Config.Simulations;
+    mcts_search(pMcts, pMcts->Config.Simulations, 0, NULL);
+}
 
-#ifdef TIMED
-    tVisits Start = Count;
+/*
+ * Simulates until the root has Simulations visits, TimeMs milliseconds have
+ * passed, or the stop flag is set. A zero TimeMs or a NULL stop flag does not
+ * limit the search. The clock is only read every few simulations.
+ */
+void mcts_search(tMcts *pMcts, tVisits Simulations, uint32_t TimeMs, atomic_bool *pStop)
+{
+    tVisits Count = mctn_visits(pMcts->pRoot), Start = Count;
     struct timespec Begin, End;
-    clock_gettime(CLOCK_REALTIME, &Begin);
-#endif
 
-    while (Count++ < Simulations)
+    clock_gettime(CLOCK_MONOTONIC, &Begin);
+
+    while (Count++ < Simulations AND pMcts->pRoot->Proof IS MCTN_PROOF_NONE)
     {
-        mcts_simulation(pMcts, pMcts->pRoot);
+        tBoard Final;
+
+        if ((Count - Start) % MCTS_CLOCK_INTERVAL == 0)
+        {
+            if (pStop ISNOT NULL AND atomic_load_explicit(pStop, memory_order_relaxed))
+            {
+                break;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &End);
+
+            if (TimeMs > 0 AND time_diff_ms(&Begin, &End) >= TimeMs)
+            {
+                break;
+            }
+        }
+
+        pMcts->Nodes -= reclaimer_step(pMcts->pReclaimer, MCTS_RECLAIM_NODES);
+
+        if (pMcts->Config.MemoryMode == MCTS_MEMORY_PRUNE AND mcts_tree_full(pMcts))
+        {
+            mcts_prune_tree(pMcts);
+        }
+
+        mcts_simulation(pMcts, pMcts->pRoot, &Final);
     }
 
 #ifdef TIMED
-    clock_gettime(CLOCK_REALTIME, &End);
-    printf("Simulations: %d, Time elapsed: %.3lf ms\n", Simulations - Start, time_diff_ms(&Begin, &End));
+    clock_gettime(CLOCK_MONOTONIC, &End);
+    printf("Simulations: %u, Time elapsed: %.3lf ms\n", mctn_visits(pMcts->pRoot) - Start, time_diff_ms(&Begin, &End));
 #endif
 }
 
@@ -84,13 +199,18 @@ tBoard *mcts_get_state(tMcts *pMcts)
 {
     tBoard *pBoard = NULL;
 
-    if (board_finished(&pMcts->pRoot->State) OR mctnlist_empty(&pMcts->pRoot->Children))
+    if (board_finished(&pMcts->pRoot->State) OR (mctnlist_empty(&pMcts->pRoot->Children) AND BitEmpty64(pMcts->pRoot->Unexpanded)))
     {
         dbg_printf(DEBUG_LEVEL_ERROR, "No state available");
         goto Error;
     }
 
-    pBoard = &mctn_most_visited_child(pMcts->pRoot)->State;
+    if (mctnlist_empty(&pMcts->pRoot->Children))
+    {
+        mcts_add_child(pMcts, pMcts->pRoot, BitScanRandom64(pMcts->pRoot->Unexpanded, &pMcts->Random));
+    }
+
+    pBoard = &mctn_best_child(pMcts->pRoot)->State;
 
 Error:
     return pBoard;
@@ -101,14 +221,25 @@ void mcts_give_state(tMcts *pMcts, tBoard *pState)
     if (NOT board_finished(&pMcts->pRoot->State))
     {
         tMctn Tmp;
+        tMctn *pRoot = pMcts->pRoot;
+        tSize Size = mctnlist_size(&pRoot->Children);
+        tVisits Visits = mctn_visits(pRoot);
 
         mctn_init(&Tmp, pState);
 
-        Tmp = mctnlist_delete(&pMcts->pRoot->Children, Tmp);
+        Tmp = mctnlist_delete(&pRoot->Children, Tmp);
 
-        mctn_free(pMcts->pRoot);
+        if (mctnlist_size(&pRoot->Children) < Size)
+        {
+            pMcts->Nodes--;
+        }
+
+        pMcts->Retained = IF (Visits > 0) THEN (float) mctn_visits(&Tmp) / Visits ELSE 0.0f;
+
+        reclaimer_discard(pMcts->pReclaimer, &pRoot->Children);
 
-        *pMcts->pRoot = Tmp;
+        *pRoot = Tmp;
+        pMcts->Counted = false;
 
         if (NOT board_finished(&pMcts->pRoot->State))
         {
@@ -117,13 +248,33 @@ void mcts_give_state(tMcts *pMcts, tBoard *pState)
     }
 }
 
+size_t mcts_tree_bytes(tMcts *pMcts)
+{
+    return (size_t) pMcts->Nodes * sizeof(tMctn);
+}
+
+float mcts_retained(tMcts *pMcts)
+{
+    return pMcts->Retained;
+}
+
 float mcts_evaluate(tMcts *pMcts)
 {
     float Eval = 0.0f;
+    tMctn *pRoot = pMcts->pRoot;
+
+    if (pRoot->Proof ISNOT MCTN_PROOF_NONE AND board_move(&pRoot->State) > 0)
+    {
+        bool Player = rules_prev_player(pMcts->pRules, &pRoot->State);
+        float Proof = IF (pRoot->Proof == MCTN_PROOF_WIN) THEN 1.0f 
+            ELSE IF (pRoot->Proof == MCTN_PROOF_LOSS) THEN -1.0f 
+            ELSE 0.0f;
 
-    if (pMcts->pRoot->Visits > 0)
+        Eval = IF (Player) THEN Proof ELSE -Proof;
+    }
+    else if (mctn_visits(pMcts->pRoot) > 0)
     {
-        float Score = pMcts->pRoot->Score / pMcts->pRoot->Visits;
+        float Score = pMcts->pRoot->Score / mctn_visits(pMcts->pRoot);
         Eval = IF (pMcts->Player) THEN (1.0f - Score) ELSE Score;
         Eval = 2.0f * Eval - 1.0f;
     }
@@ -131,38 +282,397 @@ float mcts_evaluate(tMcts *pMcts)
     return Eval;
 }
 
+/*
+ * The nodes are those in the tree, while the bytes also cover discarded nodes
+ * that have not been freed yet. After the root moves, the first call walks the
+ * tree once, and later calls only add up the branches.
+ */
+void mcts_stats(tMcts *pMcts, tMctsStats *pStats)
+{
+    tMctn *pRoot = pMcts->pRoot;
+
+    if (NOT pMcts->Counted)
+    {
+        mcts_count_tree(pMcts);
+    }
+
+    pStats->Nodes = 1;
+    pStats->Bytes = mcts_tree_bytes(pMcts);
+    pStats->MaxDepth = 0;
+
+    for (tIndex i = 0; i < mctnlist_size(&pRoot->Children); ++i)
+    {
+        tMctsBranch *pBranch = &pMcts->Branches[board_last_move_index(&mctnlist_get(&pRoot->Children, i)->State)];
+
+        pStats->Nodes += pBranch->Nodes;
+        SET_IF_GREATER(pBranch->Depth, pStats->MaxDepth);
+    }
+}
+
+/*
+ * Returns the size of the subtree of the root's child for the move at Index.
+ */
+uint32_t mcts_branch_nodes(tMcts *pMcts, tIndex Index)
+{
+    if (NOT pMcts->Counted)
+    {
+        mcts_count_tree(pMcts);
+    }
+
+    return pMcts->Branches[Index].Nodes;
+}
+
+char *mcts_string(tMcts *pMcts)
+{
+    char *Str = emalloc(MCTS_STR_LEN * sizeof(char));
+
+    mcts_string_to_buf(pMcts, Str, MCTS_STR_LEN);
+
+    return Str;
+}
+
+/*
+ * Writes the root and its children into the buffer and returns the length
+ * written, or -ENOSPC if the buffer is too small. A buffer of MCTS_STR_LEN
+ * holds a root with a child for every square.
+ */
+int mcts_string_to_buf(tMcts *pMcts, char *pBuf, size_t Cap)
+{
+    int Res;
+    size_t Length = 0;
+    tMctsStats Stats;
+    tMctn *pRoot = pMcts->pRoot;
+    tVisits Visits = mctn_visits(pRoot);
+
+    mcts_stats(pMcts, &Stats);
+
+    Res = bprintf(pBuf, Cap, &Length, "Tree size: %u, Root score: %.2f/%u\n", Stats.Nodes, pRoot->Score, Visits);
+
+    for (tIndex i = 0; i < mctnlist_size(&pRoot->Children) AND Res == 0; ++i)
+    {
+        tMctn *pChild = mctnlist_get(&pRoot->Children, i);
+        tIndex Index = board_last_move_index(&pChild->State);
+        tVisits ChildVisits = mctn_visits(pChild);
+        float Eval = IF (ChildVisits > 0) THEN pChild->Score/ChildVisits ELSE 0.0f;
+        char Id[BOARD_ID_STR_LEN];
+
+        board_index_id_to_buf(Index, Id, sizeof(Id));
+
+        Res = bprintf(pBuf, Cap, &Length, "%s: %0.2f @ %.2f/%u ** %u Nodes ** %3.3e UCT\n",
+            Id, Eval, pChild->Score, ChildVisits, pMcts->Branches[Index].Nodes,
+            mctn_uct(Visits, ChildVisits, pChild->Score));
+    }
+
+    return IF (Res < 0) THEN Res ELSE (int) Length;
+}
+
+/*
+ * Writes the tree as a header, with the root position and a hash of the rules,
+ * followed by the nodes in depth-first order. A node records its move, its
+ * statistics, and how many of its children follow it. Nodes deeper than Depth
+ * (0 keeps every level) or with fewer than MinVisits visits are written without
+ * their children, as leaves that are expanded again when reached, as after
+ * pruning.
+ */
+int mcts_save(tMcts *pMcts, FILE *pFile, tSize Depth, tVisits MinVisits)
+{
+    int Res = 0;
+    tMctsTreeHeader Header;
+
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, MCTS_TREE_MAGIC, sizeof(Header.Magic));
+    Header.Version = MCTS_TREE_VERSION;
+    Header.Rules = mcts_rules_hash(pMcts->pRules);
+    Header.Data = pMcts->pRoot->State.Data;
+    Header.Empty = pMcts->pRoot->State.Empty;
+
+    if (fwrite(&Header, sizeof(Header), 1, pFile) ISNOT 1)
+    {
+        Res = -EIO;
+        goto Error;
+    }
+
+    Res = mcts_save_node(pFile, pMcts->pRoot, IF (Depth == 0) THEN ROWS*COLUMNS ELSE Depth, MinVisits);
+
+Error:
+    return Res;
+}
+
+/*
+ * Replaces the tree with one written by mcts_save, which is only accepted for
+ * the same rules and root position. The tree is left as it was if the file
+ * cannot be read, and the nodes it replaces are freed like those of a move.
+ */
+int mcts_load(tMcts *pMcts, FILE *pFile)
+{
+    int Res = 0;
+    uint32_t Nodes = 1;
+    tMctsTreeHeader Header;
+    tMctsTreeNode Record;
+    tMctn Root;
+
+    if (fread(&Header, sizeof(Header), 1, pFile) ISNOT 1 OR memcmp(Header.Magic, MCTS_TREE_MAGIC, sizeof(Header.Magic)) ISNOT 0
+        OR Header.Version ISNOT MCTS_TREE_VERSION)
+    {
+        Res = -EINVAL;
+        dbg_printf(DEBUG_LEVEL_ERROR, "Invalid search tree");
+        goto Error;
+    }
+
+    if (Header.Rules ISNOT mcts_rules_hash(pMcts->pRules) OR Header.Data ISNOT pMcts->pRoot->State.Data
+        OR Header.Empty ISNOT pMcts->pRoot->State.Empty)
+    {
+        Res = -ESRCH;
+        dbg_printf(DEBUG_LEVEL_WARN, "Search tree is for another position");
+        goto Error;
+    }
+
+    Res = mcts_read_node(pMcts, pFile, NULL, &Record);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
+    mctn_init(&Root, &pMcts->pRoot->State);
+
+    Res = mcts_load_node(pMcts, pFile, &Root, &Record, &Nodes);
+    if (Res < 0)
+    {
+        mctn_free(&Root);
+        dbg_printf(DEBUG_LEVEL_ERROR, "Invalid search tree");
+        goto Error;
+    }
+
+    reclaimer_discard(pMcts->pReclaimer, &pMcts->pRoot->Children);
+
+    *pMcts->pRoot = Root;
+    pMcts->Nodes += Nodes - 1;
+    pMcts->Counted = false;
+
+Error:
+    return Res;
+}
+
+/*
+ * Unless RAVE needs every sibling to gather its statistics, moves are kept in
+ * the node's unexpanded mask and a child is only allocated when it is first
+ * selected, so a simulation adds about one node to the tree. The first playout
+ * from a new leaf starts from a random move without allocating anything.
+ */
 static void mcts_expand_node(tMcts *pMcts, tMctn *pNode)
 {
-    tSize Size;
-    tBoard* pStates = rules_next_states(pMcts->pRules, &pNode->State, &Size, pMcts->Config.SearchOnlyNeighbors);
+    if (pMcts->Config.Widening > 0)
+    {
+        pNode->Unexpanded = rules_indices(pMcts->pRules, &pNode->State, pMcts->Config.SearchOnlyNeighbors);
+        mcts_widen_node(pMcts, pNode);
+    }
+    else if (pMcts->Config.RaveEquivalence == 0)
+    {
+        pNode->Unexpanded = rules_indices(pMcts->pRules, &pNode->State, pMcts->Config.SearchOnlyNeighbors);
+    }
+    else
+    {
+        tSize Size;
+        tBoard* pStates = rules_next_states(pMcts->pRules, &pNode->State, &Size, pMcts->Config.SearchOnlyNeighbors);
+
+        bool Player = rules_player(pMcts->pRules, &pNode->State);
+
+        mctn_expand(pNode, pStates, Size);
+        mctnlist_shuffle(&pNode->Children, &pMcts->Random);
+
+        for (tIndex i = 0; i < Size; ++i)
+        {
+            tMctn *pChild = mctnlist_get(&pNode->Children, i);
+
+            pChild->Prior = mcts_prior(&pNode->State, board_last_move_index(&pChild->State), Player);
+            mcts_count_child(pMcts, pChild);
+        }
+
+        free(pStates);
+    }
+}
+
+/*
+ * With progressive widening, a node visited n times only has ceil(W*sqrt(n+1))
+ * children. The other moves wait in its unexpanded mask and are added in prior
+ * order as the visits grow.
+ */
+static void mcts_widen_node(tMcts *pMcts, tMctn *pNode)
+{
+    float Limit = ceilf(pMcts->Config.Widening * sqrtf(mctn_visits(pNode) + 1.0f));
+    bool Player = rules_player(pMcts->pRules, &pNode->State);
+
+    while (mctnlist_size(&pNode->Children) < Limit AND NOT BitEmpty64(pNode->Unexpanded))
+    {
+        mcts_add_child(pMcts, pNode, mcts_prior_index(pMcts, &pNode->State, pNode->Unexpanded, Player, NULL));
+    }
+}
+
+static tMctn *mcts_add_child(tMcts *pMcts, tMctn *pNode, tIndex Index)
+{
+    tBoard State;
+    tMctn *pChild;
+    bool Player = rules_player(pMcts->pRules, &pNode->State);
+
+    board_copy(&State, &pNode->State);
+    board_advance(&State, Index, Player);
+    pNode->Unexpanded &= ~(1ULL << Index);
+
+    pChild = mctn_add_child(pNode, &State);
+    pChild->Prior = mcts_prior(&pNode->State, Index, Player);
+
+    mcts_count_child(pMcts, pChild);
+
+    return pChild;
+}
+
+/*
+ * Returns the move with the highest prior, breaking ties at random, and adds
+ * up the priors of all the moves if asked to.
+ */
+static tIndex mcts_prior_index(tMcts *pMcts, tBoard *pState, uint64_t Indices, bool Player, float *pPriorSum)
+{
+    uint64_t Best = 0ULL;
+    uint8_t BestPrior = 0;
+
+    while (NOT BitEmpty64(Indices))
+    {
+        tIndex Index = BitTzCount64(Indices);
+        uint8_t Prior = mcts_prior(pState, Index, Player);
+
+        if (pPriorSum ISNOT NULL)
+        {
+            *pPriorSum += Prior;
+        }
+
+        if (Prior > BestPrior)
+        {
+            BestPrior = Prior;
+            Best = 0ULL;
+        }
+
+        if (Prior == BestPrior)
+        {
+            BitSet64(&Best, Index);
+        }
+
+        BitReset64(&Indices, Index);
+    }
+
+    return BitScanRandom64(Best, &pMcts->Random);
+}
+
+/*
+ * PUCT selection. The unexpanded moves compete with the children through their
+ * priors at the first play urgency, which is the parent's mean result, so the
+ * best of them is only added once it would beat every child.
+ */
+static tMctn *mcts_select_puct(tMcts *pMcts, tMctn *pNode, bool CanExpand)
+{
+    tMctnPuct Puct;
+    tMctn *pChild = NULL;
+    tBoard *pState = &pNode->State;
+    tVisits Visits = mctn_visits(pNode);
+    tSize Size = mctnlist_size(&pNode->Children);
+    bool Player = rules_player(pMcts->pRules, pState);
+    float Value = -FLT_MAX, Fpu = IF (Visits > 0) THEN pNode->Score/Visits ELSE BOARD_DRAW;
+    tIndex Index = 0;
+
+    Puct.Exploration = pMcts->Config.PriorExploration;
+    Puct.PriorSum = 0.0f;
+    Puct.Fpu = IF (rules_prev_player(pMcts->pRules, pState) == Player) THEN Fpu ELSE 1.0f - Fpu;
+
+    for (tIndex i = 0; i < Size; ++i)
+    {
+        Puct.PriorSum += mctnlist_get(&pNode->Children, i)->Prior;
+    }
+
+    if (NOT BitEmpty64(pNode->Unexpanded))
+    {
+        Index = mcts_prior_index(pMcts, pState, pNode->Unexpanded, Player, &Puct.PriorSum);
+    }
+
+    if (Size > 0)
+    {
+        pChild = mctn_best_child_uct(pNode, pMcts->Config.RaveEquivalence, &Puct, &Value);
+    }
+
+    if (CanExpand AND NOT BitEmpty64(pNode->Unexpanded) AND (pChild == NULL OR pChild->Proof ISNOT MCTN_PROOF_NONE
+        OR mctn_puct(&Puct, Visits, 0, Puct.Fpu, mcts_prior(pState, Index, Player)) > Value))
+    {
+        pChild = mcts_add_child(pMcts, pNode, Index);
+    }
 
-    mctn_expand(pNode, pStates, Size);
-    mctnlist_shuffle(&pNode->Children, &pMcts->Random);
-    free(pStates);
+    return pChild;
 }
 
-static float mcts_simulation(tMcts *pMcts, tMctn *pNode)
+static float mcts_simulation(tMcts *pMcts, tMctn *pNode, tBoard *pFinal)
 {
     float Res;
     tRules *pRules = pMcts->pRules;
     tBoard *pState = &pNode->State;
     tRandom *pRandom = &pMcts->Random;
+    tMctn *pChild = NULL;
 
-    if (mctnlist_empty(&pNode->Children))
+    if (mctnlist_empty(&pNode->Children) AND BitEmpty64(pNode->Unexpanded))
     {
-        if (NOT board_finished(pState))
+        if (NOT board_finished(pState) AND NOT mcts_tree_full(pMcts))
         {
             mcts_expand_node(pMcts, pNode);
-            Res = mcts_simulate_playout(pMcts, &mctn_random_child(pNode, pRandom)->State);
+
+            if (mctnlist_empty(&pNode->Children))
+            {
+                Res = mcts_simulate_unexpanded(pMcts, pNode, pFinal);
+            }
+            else
+            {
+                pChild = mctn_random_child(pNode, pRandom);
+                Res = mcts_simulate_playout(pMcts, &pChild->State, pFinal);
+
+                if (board_finished(&pChild->State))
+                {
+                    mcts_prove_node(pMcts, pChild);
+                }
+            }
         }
         else 
         {
-            Res = mcts_simulate_playout(pMcts, pState);
+            Res = mcts_simulate_playout(pMcts, pState, pFinal);
         }
     }
     else
     {
-        Res = mcts_simulation(pMcts, mctn_best_child_uct(pNode));
+        bool Full = mcts_tree_full(pMcts);
+
+        if (pMcts->Config.Widening > 0 AND NOT Full)
+        {
+            mcts_widen_node(pMcts, pNode);
+        }
+
+        if (pMcts->Config.PriorExploration > 0.0f)
+        {
+            pChild = mcts_select_puct(pMcts, pNode, pMcts->Config.Widening == 0 AND NOT Full);
+        }
+        else if (pMcts->Config.Widening == 0 AND NOT BitEmpty64(pNode->Unexpanded) AND NOT Full)
+        {
+            pChild = mcts_add_child(pMcts, pNode, BitScanRandom64(pNode->Unexpanded, pRandom));
+        }
+        else if (NOT mctnlist_empty(&pNode->Children))
+        {
+            pChild = mctn_best_child_uct(pNode, pMcts->Config.RaveEquivalence, NULL, NULL);
+        }
+
+        if (pNode == pMcts->pRoot AND pChild ISNOT NULL)
+        {
+            pMcts->Branch = board_last_move_index(&pChild->State);
+        }
+
+        Res = IF (pChild ISNOT NULL) THEN mcts_simulation(pMcts, pChild, pFinal) ELSE mcts_simulate_unexpanded(pMcts, pNode, pFinal);
+    }
+
+    if (board_finished(pState) OR (pChild ISNOT NULL AND pChild->Proof ISNOT MCTN_PROOF_NONE))
+    {
+        mcts_prove_node(pMcts, pNode);
     }
 
     if (NOT board_finished(pState))
@@ -171,20 +681,34 @@ static float mcts_simulation(tMcts *pMcts, tMctn *pNode)
         float Score = IF (Player == pMcts->Player) THEN Res ELSE 1.0f - Res;
 
         mctn_update(pNode, Score);
+
+        if (pMcts->Config.RaveEquivalence > 0)
+        {
+            mcts_update_amaf(pMcts, pNode, pFinal, Res);
+        }
     }
 
     return Res;
 }
 
-static float mcts_simulate_playout(tMcts *pMcts, tBoard *pState)
+static float mcts_simulate_unexpanded(tMcts *pMcts, tMctn *pNode, tBoard *pFinal)
+{
+    tBoard State;
+
+    board_copy(&State, &pNode->State);
+    board_advance(&State, BitScanRandom64(pNode->Unexpanded, &pMcts->Random), rules_player(pMcts->pRules, &pNode->State));
+
+    return mcts_simulate_playout(pMcts, &State, pFinal);
+}
+
+static float mcts_simulate_playout(tMcts *pMcts, tBoard *pState, tBoard *pFinal)
 {
     float Score;
-    tBoard Board;
 
-    board_copy(&Board, pState);
-    rules_simulate_playout(pMcts->pRules, &Board, &pMcts->Random, pMcts->Config.SearchOnlyNeighbors);
+    board_copy(pFinal, pState);
+    rules_simulate_playout(pMcts->pRules, pFinal, &pMcts->Random, pMcts->Config.SearchOnlyNeighbors);
     
-    Score = mcts_weight_score(board_score(&Board));
+    Score = mcts_weight_score(board_score(pFinal));
 
     if (NOT pMcts->Player)
     {
@@ -194,6 +718,344 @@ static float mcts_simulate_playout(tMcts *pMcts, tBoard *pState)
     return Score;
 }
 
+/*
+ * The finished board of the simulation holds every move made after pNode, both
+ * in the tree and in the playout, so a child is updated as if it had been
+ * played first whenever its square was later taken by the player moving here.
+ */
+static void mcts_update_amaf(tMcts *pMcts, tMctn *pNode, tBoard *pFinal, float Res)
+{
+    bool Player = rules_player(pMcts->pRules, &pNode->State);
+    float Score = IF (Player == pMcts->Player) THEN Res ELSE 1.0f - Res;
+
+    for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
+    {
+        tMctn *pChild = mctnlist_get(&pNode->Children, i);
+        tIndex Index = board_last_move_index(&pChild->State);
+
+        if (NOT board_index_empty(pFinal, Index) AND board_index_player(pFinal, Index) == Player)
+        {
+            mctn_update_amaf(pChild, Score);
+        }
+    }
+}
+
+/*
+ * Like scores, proofs are from the perspective of the player who moved into
+ * the node. A node is won by the player to move as soon as one child is a win,
+ * otherwise it is only proven once every legal move has a proven child.
+ */
+static void mcts_prove_node(tMcts *pMcts, tMctn *pNode)
+{
+    tRules *pRules = pMcts->pRules;
+    tBoard *pState = &pNode->State;
+    bool PrevPlayer = rules_prev_player(pRules, pState);
+
+    if (board_finished(pState))
+    {
+        tScore Score = board_score(pState);
+
+        pNode->Proof = IF (Score == 0) THEN MCTN_PROOF_DRAW
+            ELSE IF ((Score > 0) == PrevPlayer) THEN MCTN_PROOF_WIN
+            ELSE MCTN_PROOF_LOSS;
+    }
+    else
+    {
+        bool Player = rules_player(pRules, pState);
+        tSize Size = mctnlist_size(&pNode->Children);
+        bool Covered = Size == BitPopCount64(rules_indices(pRules, pState, false));
+        uint8_t Proof = MCTN_PROOF_LOSS;
+
+        for (tIndex i = 0; i < Size; ++i)
+        {
+            tMctn *pChild = mctnlist_get(&pNode->Children, i);
+
+            if (pChild->Proof IS MCTN_PROOF_NONE)
+            {
+                Covered = false;
+            }
+            else
+            {
+                SET_IF_GREATER(pChild->Proof, Proof);
+            }
+        }
+
+        if (Proof == MCTN_PROOF_WIN OR Covered)
+        {
+            pNode->Proof = IF (Player == PrevPlayer) THEN Proof ELSE MCTN_PROOF_WIN + MCTN_PROOF_LOSS - Proof;
+        }
+    }
+}
+
+/*
+ * The tree is full once it could not take another fully expanded node without
+ * going over the memory budget, so the budget is never exceeded.
+ */
+static bool mcts_tree_full(tMcts *pMcts)
+{
+    size_t Budget = pMcts->Config.MemoryBudget;
+
+    return Budget > 0 AND mcts_tree_bytes(pMcts) + ROWS*COLUMNS * sizeof(tMctn) > Budget;
+}
+
+/*
+ * Frees the children of every node with fewer visits than a threshold, which
+ * doubles until the tree is down to half of the budget. The root keeps its
+ * children, and pruned nodes become leaves that are expanded again if reached.
+ */
+static void mcts_prune_tree(tMcts *pMcts)
+{
+    size_t Target = pMcts->Config.MemoryBudget / 2;
+
+    for (uint32_t Threshold = 2; mcts_tree_bytes(pMcts) > Target AND Threshold <= mctn_visits(pMcts->pRoot); Threshold *= 2)
+    {
+        pMcts->Nodes -= mcts_prune_node(pMcts->pRoot, Threshold);
+    }
+
+    pMcts->Counted = false;
+}
+
+/*
+ * Counts a new node towards the tree and, unless the branches are to be counted
+ * again, towards the branch of the root that the simulation is in.
+ */
+static void mcts_count_child(tMcts *pMcts, tMctn *pChild)
+{
+    tSize Depth = board_move(&pChild->State) - board_move(&pMcts->pRoot->State);
+    tMctsBranch *pBranch;
+
+    pMcts->Nodes++;
+
+    if (pMcts->Counted)
+    {
+        if (Depth == 1)
+        {
+            pBranch = &pMcts->Branches[board_last_move_index(&pChild->State)];
+            pBranch->Nodes = 0;
+            pBranch->Depth = 0;
+        }
+        else
+        {
+            pBranch = &pMcts->Branches[pMcts->Branch];
+        }
+
+        pBranch->Nodes++;
+        SET_IF_GREATER(Depth, pBranch->Depth);
+    }
+}
+
+/*
+ * Walks the tree once to count its branches after the root moves, a tree is
+ * loaded or the tree is pruned, which are the only times that nodes leave a
+ * branch or the depths change. New nodes are counted as they are added.
+ */
+static void mcts_count_tree(tMcts *pMcts)
+{
+    tMctn *pRoot = pMcts->pRoot;
+
+    for (tIndex i = 0; i < mctnlist_size(&pRoot->Children); ++i)
+    {
+        tMctn *pChild = mctnlist_get(&pRoot->Children, i);
+        tMctsBranch *pBranch = &pMcts->Branches[board_last_move_index(&pChild->State)];
+
+        pBranch->Nodes = 0;
+        pBranch->Depth = 0;
+
+        mcts_count_node(pChild, 1, pBranch);
+    }
+
+    pMcts->Counted = true;
+}
+
+static int mcts_save_node(FILE *pFile, tMctn *pNode, tSize Depth, tVisits MinVisits)
+{
+    int Res = 0;
+    tMctsTreeNode Record;
+    bool Keep = Depth > 0 AND mctn_visits(pNode) >= MinVisits;
+
+    Record.Unexpanded = IF Keep THEN pNode->Unexpanded ELSE 0ULL;
+    Record.Visits = mctn_visits(pNode);
+    Record.AmafVisits = mctn_amaf_visits(pNode);
+    Record.Score = pNode->Score;
+    Record.AmafScore = pNode->AmafScore;
+    Record.Index = IF (board_move(&pNode->State) > 0) THEN board_last_move_index(&pNode->State) ELSE MCTS_TREE_NO_INDEX;
+    Record.Children = IF Keep THEN mctnlist_size(&pNode->Children) ELSE 0;
+    Record.Proof = pNode->Proof;
+    Record.Prior = pNode->Prior;
+
+    if (fwrite(&Record, sizeof(Record), 1, pFile) ISNOT 1)
+    {
+        Res = -EIO;
+        goto Error;
+    }
+
+    for (tIndex i = 0; i < Record.Children AND Res == 0; ++i)
+    {
+        Res = mcts_save_node(pFile, mctnlist_get(&pNode->Children, i), Depth - 1, MinVisits);
+    }
+
+Error:
+    return Res;
+}
+
+/*
+ * Fills in a node from its record and reads its children, each of which must
+ * be a legal move that is neither unexpanded nor already a child.
+ */
+static int mcts_load_node(tMcts *pMcts, FILE *pFile, tMctn *pNode, tMctsTreeNode *pRecord, uint32_t *pNodes)
+{
+    int Res = 0;
+    uint64_t Used = pRecord->Unexpanded;
+
+    pNode->Unexpanded = pRecord->Unexpanded;
+    pNode->Score = pRecord->Score;
+    pNode->AmafScore = pRecord->AmafScore;
+    pNode->Proof = pRecord->Proof;
+    pNode->Prior = pRecord->Prior;
+    mctn_set_visits(pNode, pRecord->Visits, pRecord->AmafVisits);
+
+    for (tIndex i = 0; i < pRecord->Children; ++i)
+    {
+        tMctsTreeNode Record;
+        tMctn *pChild;
+        tBoard State;
+
+        Res = mcts_read_node(pMcts, pFile, &pNode->State, &Record);
+        if (Res < 0 OR BitTest64(Used, Record.Index))
+        {
+            Res = -EINVAL;
+            goto Error;
+        }
+
+        BitSet64(&Used, Record.Index);
+
+        board_copy(&State, &pNode->State);
+        board_advance(&State, Record.Index, rules_player(pMcts->pRules, &pNode->State));
+
+        pChild = mctn_add_child(pNode, &State);
+        (*pNodes)++;
+
+        Res = mcts_load_node(pMcts, pFile, pChild, &Record, pNodes);
+        if (Res < 0)
+        {
+            goto Error;
+        }
+    }
+
+Error:
+    return Res;
+}
+
+/*
+ * Reads a record and checks it against the state of its parent, or of the root
+ * if there is no parent.
+ */
+static int mcts_read_node(tMcts *pMcts, FILE *pFile, tBoard *pState, tMctsTreeNode *pRecord)
+{
+    int Res = 0;
+    tBoard State;
+    uint64_t Indices;
+
+    if (fread(pRecord, sizeof(tMctsTreeNode), 1, pFile) ISNOT 1)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    if (pState ISNOT NULL)
+    {
+        Indices = rules_indices(pMcts->pRules, pState, false);
+
+        if (pRecord->Index >= ROWS*COLUMNS OR NOT BitTest64(Indices, pRecord->Index))
+        {
+            Res = -EINVAL;
+            goto Error;
+        }
+
+        board_copy(&State, pState);
+        board_advance(&State, pRecord->Index, rules_player(pMcts->pRules, pState));
+        pState = &State;
+    }
+    else
+    {
+        pState = &pMcts->pRoot->State;
+    }
+
+    Indices = IF board_finished(pState) THEN 0ULL ELSE rules_indices(pMcts->pRules, pState, false);
+
+    if ((pRecord->Unexpanded & ~Indices) ISNOT 0ULL OR pRecord->Children > BitPopCount64(Indices)
+        OR pRecord->Proof > MCTN_PROOF_WIN OR pRecord->Visits > TVISITS_MAX OR pRecord->AmafVisits > TVISITS_MAX)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+Error:
+    return Res;
+}
+
+/*
+ * The prior of a move grows with the trains it could extend, counting the ends
+ * of the player's trains most, then its other own and opposing neighbours, and
+ * with how close it is to the centre.
+ */
+static uint8_t mcts_prior(tBoard *pState, tIndex Index, bool Player)
+{
+    uint64_t NotEmpty = ~pState->Empty & BOARD_MASK;
+    uint64_t Own = IF Player THEN pState->Data & NotEmpty ELSE ~pState->Data & NotEmpty;
+    uint64_t Adjacent = board_index_adjacent(Index), OwnAdjacent = Adjacent & Own, Indices = OwnAdjacent;
+    tSize Ends = 0, OwnCount = IF (BitPopCount64(OwnAdjacent) > 2) THEN 2 ELSE BitPopCount64(OwnAdjacent);
+    int Row = Index / COLUMNS, Column = Index % COLUMNS;
+    int Distance = abs(Row - MCTS_PRIOR_CENTER) + abs(Column - MCTS_PRIOR_CENTER);
+
+    while (NOT BitEmpty64(Indices))
+    {
+        tIndex Neighbor = BitTzCount64(Indices);
+
+        if (BitPopCount64(board_index_adjacent(Neighbor) & Own) <= 1)
+        {
+            Ends++;
+        }
+
+        BitReset64(&Indices, Neighbor);
+    }
+
+    return 1 + 4*Ends + 2*OwnCount + BitPopCount64(Adjacent & NotEmpty & ~Own) + (2*MCTS_PRIOR_CENTER - Distance);
+}
+
+static uint32_t mcts_prune_node(tMctn *pNode, uint32_t Threshold)
+{
+    uint32_t Count = 0;
+
+    if (mctn_visits(pNode) < Threshold)
+    {
+        Count = mctn_free(pNode);
+
+        mctnlist_init(&pNode->Children);
+        pNode->Unexpanded = 0ULL;
+    }
+    else
+    {
+        for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
+        {
+            Count += mcts_prune_node(mctnlist_get(&pNode->Children, i), Threshold);
+        }
+    }
+
+    return Count;
+}
+
+static void mcts_count_node(tMctn *pNode, tSize Depth, tMctsBranch *pBranch)
+{
+    pBranch->Nodes++;
+    SET_IF_GREATER(Depth, pBranch->Depth);
+
+    for (tIndex i = 0; i < mctnlist_size(&pNode->Children); ++i)
+    {
+        mcts_count_node(mctnlist_get(&pNode->Children, i), Depth + 1, pBranch);
+    }
+}
+
 static float mcts_weight_score(tScore Score)
 {
     float Res;
@@ -216,9 +1078,20 @@ static float mcts_weight_score(tScore Score)
     return Res;
 }
 
-#ifdef TIMED
+static uint64_t mcts_rules_hash(tRules *pRules)
+{
+    uint64_t Hash = 0ULL;
+
+    for (tIndex i = 0; i < ROWS*COLUMNS; ++i)
+    {
+        Hash = (Hash ^ pRules->MovePolicies[i]) * MCTS_HASH_RULES;
+        Hash ^= Hash >> 32;
+    }
+
+    return Hash;
+}
+
 static double time_diff_ms(struct timespec *pBegin, struct timespec *pEnd)
 {
     return (pEnd->tv_sec * 1.0e3 + pEnd->tv_nsec / 1.0e6) - (pBegin->tv_sec * 1.0e3 + pBegin->tv_nsec / 1.0e6);
 }
-#endif
@@ -1,26 +1,72 @@
 #ifndef __MCTS_H__
 #define __MCTS_H__
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include "board.h"
 #include "mctn.h"
+#include "mctnlist.h"
 #include "random.h"
+#include "reclaimer.h"
 #include "rules.h"
+#include "types.h"
+
+#define MCTS_STR_LEN    4096
+
+typedef enum MctsMemoryMode
+{
+    MCTS_MEMORY_STOP    = 0,
+    MCTS_MEMORY_PRUNE   = 1,
+}
+eMctsMemoryMode;
 
 typedef struct MctsConfig 
 {
     tVisits Simulations;
     bool SearchOnlyNeighbors;
+    uint32_t RaveEquivalence;
+    tSize Widening;
+    size_t MemoryBudget;
+    eMctsMemoryMode MemoryMode;
+    bool BackgroundFree;
+    float PriorExploration;
 }
 tMctsConfig;
 
+/*
+ * The nodes below a child of the root and the depth of the deepest of them.
+ */
+typedef struct MctsBranch
+{
+    uint32_t Nodes;
+    tSize Depth;
+}
+tMctsBranch;
+
+typedef struct MctsStats
+{
+    uint32_t Nodes;
+    size_t Bytes;
+    tSize MaxDepth;
+}
+tMctsStats;
+
 typedef struct Mcts
 {
     tMctn *pRoot;
     tRules *pRules;
     tRandom Random;
     tMctsConfig Config;
+    uint32_t Nodes;
+    tMctsBranch Branches[ROWS*COLUMNS];
+    tIndex Branch;
+    bool Counted;
+    tReclaimer *pReclaimer;
+    float Retained;
     bool Player;
 } 
 tMcts;
@@ -28,9 +74,19 @@ tMcts;
 void mcts_init(tMcts *pMcts, tRules *pRules, tBoard *pState, tMctsConfig *pConfig);
 void mcts_config_init(tMctsConfig *pConfig);
 void mcts_free(tMcts *pMcts);
+void mcts_reset(tMcts *pMcts, tBoard *pState);
 void mcts_simulate(tMcts *pMcts);
+void mcts_search(tMcts *pMcts, tVisits Simulations, uint32_t TimeMs, atomic_bool *pStop);
 tBoard *mcts_get_state(tMcts *pMcts);
 void mcts_give_state(tMcts *pMcts, tBoard *pState);
+size_t mcts_tree_bytes(tMcts *pMcts);
+float mcts_retained(tMcts *pMcts);
 float mcts_evaluate(tMcts *pMcts);
+void mcts_stats(tMcts *pMcts, tMctsStats *pStats);
+uint32_t mcts_branch_nodes(tMcts *pMcts, tIndex Index);
+char *mcts_string(tMcts *pMcts);
+int mcts_string_to_buf(tMcts *pMcts, char *pBuf, size_t Cap);
+int mcts_save(tMcts *pMcts, FILE *pFile, tSize Depth, tVisits MinVisits);
+int mcts_load(tMcts *pMcts, FILE *pFile);
 
 #endif
@@ -0,0 +1,198 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bitutil.h"
+#include "board.h"
+#include "pathfinder.h"
+#include "types.h"
+#include "util.h"
+
+typedef struct PathfinderFrame
+{
+    uint64_t Remaining;
+    uint64_t Next;
+    tSize Length;
+}
+tPathfinderFrame;
+
+static uint64_t pathfinder_fill(uint64_t Seed, uint64_t Data);
+static tSize pathfinder_bound(uint64_t Data, tIndex Index);
+static tSize pathfinder_component_bound(uint64_t Component, uint64_t Head);
+static tSize pathfinder_edges(uint64_t Area);
+
+uint64_t pathfinder_area(uint64_t Data, tIndex Index)
+{
+    uint64_t Seed = 0ULL;
+
+    BitSet64(&Seed, Index);
+
+    return pathfinder_fill(Seed, Data | Seed);
+}
+
+tSize pathfinder_area_loops(uint64_t Area)
+{
+    return pathfinder_edges(Area) + 1 - BitPopCount64(Area);
+}
+
+tSize pathfinder_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea)
+{
+    bool Capped;
+
+    return pathfinder_search(Data, Index, pArea, &Capped);
+}
+
+/*
+ * Iterative depth-first search over an explicit stack with branch and bound.
+ * A branch is cut when its length plus an upper bound on the cells it can still
+ * reach cannot beat the longest path found so far, and the search ends as soon
+ * as the longest path meets the bound of the whole area. The number of
+ * expansions is capped at PATHFINDER_MAX_EXPANSIONS, after which the longest
+ * path found so far is returned and Capped is set, as it may not be exact.
+ */
+tSize pathfinder_search(uint64_t Data, tIndex Index, uint64_t *pArea, bool *pCapped)
+{
+    tPathfinderFrame Stack[ROWS*COLUMNS];
+    tPathfinderFrame *pFrame = &Stack[0];
+    uint64_t Area = pathfinder_area(Data, Index), Head = 0ULL;
+    uint32_t Expansions = 0U;
+    tSize Depth = 1, MaxPathLength = 1, MaxBound;
+
+    BitSet64(&Head, Index);
+
+    *pCapped = false;
+    *pArea |= Area;
+    Data = Area & ~Head;
+
+    pFrame->Remaining = Data;
+    pFrame->Next = BOARD_EXPAND(Head) & Data;
+    pFrame->Length = 1;
+
+    MaxBound = 1 + pathfinder_bound(Data, Index);
+
+    while (Depth > 0 AND MaxPathLength < MaxBound)
+    {
+        pFrame = &Stack[Depth-1];
+
+        if (BitEmpty64(pFrame->Next))
+        {
+            Depth--;
+            continue;
+        }
+
+        tIndex Next = BitTzCount64(pFrame->Next);
+        uint64_t Remaining = pFrame->Remaining;
+        tSize Length = pFrame->Length + 1;
+
+        BitReset64(&pFrame->Next, Next);
+        BitReset64(&Remaining, Next);
+
+        uint64_t Exits = BOARD_EXPAND(1ULL << Next) & Remaining;
+
+        SET_IF_GREATER(Length, MaxPathLength);
+
+        if (BitEmpty64(Exits)
+            OR Length + BitPopCount64(Remaining) <= MaxPathLength
+            OR (BitPopCount64(Exits) > 1 AND Length + pathfinder_bound(Remaining, Next) <= MaxPathLength)
+            OR *pCapped)
+        {
+            continue;
+        }
+
+        if (++Expansions > PATHFINDER_MAX_EXPANSIONS)
+        {
+            *pCapped = true;
+            continue;
+        }
+
+        pFrame = &Stack[Depth++];
+
+        pFrame->Remaining = Remaining;
+        pFrame->Next = Exits;
+        pFrame->Length = Length;
+    }
+
+    return MaxPathLength;
+}
+
+static uint64_t pathfinder_fill(uint64_t Seed, uint64_t Data)
+{
+    uint64_t Fill = Seed & Data, Prev;
+
+    do
+    {
+        Prev = Fill;
+        Fill |= BOARD_EXPAND(Fill) & Data;
+    }
+    while (Fill != Prev);
+
+    return Fill;
+}
+
+/*
+ * Once the path is at Index, it can only continue into one of the components
+ * of the remaining cells that touch Index, so Index acts as an articulation
+ * point and the bound is the best bound of those components.
+ */
+static tSize pathfinder_bound(uint64_t Data, tIndex Index)
+{
+    uint64_t Head = 1ULL << Index;
+    uint64_t Exits = BOARD_EXPAND(Head) & Data;
+    tSize Bound, MaxBound = 0;
+
+    while (NOT BitEmpty64(Exits))
+    {
+        uint64_t Component = pathfinder_fill(Exits & -Exits, Data);
+
+        Exits &= ~Component;
+        Bound = pathfinder_component_bound(Component, Head);
+
+        SET_IF_GREATER(Bound, MaxBound);
+    }
+
+    return MaxBound;
+}
+
+/*
+ * The board is bipartite, so a path leaving Head alternates between cells of
+ * the other color and cells of the color of Head. Cells with a single neighbor
+ * can only end a path, so at most one of them can be used.
+ */
+static tSize pathfinder_component_bound(uint64_t Component, uint64_t Head)
+{
+    uint64_t Graph = Component | Head;
+    uint64_t Left = (Graph >> 1) & ~BOARD_COLUMN_G & Component;
+    uint64_t Right = (Graph << 1) & ~BOARD_COLUMN_A & Component;
+    uint64_t Top = (Graph >> COLUMNS) & Component;
+    uint64_t Bottom = (Graph << COLUMNS) & Component;
+    uint64_t Multiple = (Left & Right) | (Left & Top) | (Left & Bottom) | (Right & Top) | (Right & Bottom) | (Top & Bottom);
+    uint64_t Leaves = (Left | Right | Top | Bottom) & ~Multiple;
+
+    uint64_t Same = IF BitEmpty64(Head & BOARD_EVEN_MASK) THEN Component & ~BOARD_EVEN_MASK ELSE Component & BOARD_EVEN_MASK;
+    tSize SameCount = BitPopCount64(Same), OtherCount = BitPopCount64(Component & ~Same);
+    tSize LeafCount = BitPopCount64(Leaves);
+
+    tSize Bound = BitPopCount64(Component);
+
+    if (LeafCount > 1 AND Bound > LeafCount - 1)
+    {
+        Bound -= LeafCount - 1;
+    }
+
+    if (2 * OtherCount < Bound)
+    {
+        Bound = 2 * OtherCount;
+    }
+
+    if (2 * SameCount + 1 < Bound)
+    {
+        Bound = 2 * SameCount + 1;
+    }
+
+    return Bound;
+}
+
+static tSize pathfinder_edges(uint64_t Area)
+{
+    return BitPopCount64(Area & (Area >> 1) & ~BOARD_COLUMN_G)
+         + BitPopCount64(Area & (Area >> COLUMNS));
+}
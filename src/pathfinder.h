@@ -0,0 +1,17 @@
+#ifndef __PATHFINDER_H__
+#define __PATHFINDER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "types.h"
+
+#define PATHFINDER_MAX_EXPANSIONS   (1U << 18)
+
+uint64_t pathfinder_area(uint64_t Data, tIndex Index);
+tSize pathfinder_area_loops(uint64_t Area);
+tSize pathfinder_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea);
+tSize pathfinder_search(uint64_t Data, tIndex Index, uint64_t *pArea, bool *pCapped);
+
+#endif
@@ -0,0 +1,393 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "board.h"
+#include "engine.h"
+#include "mctn.h"
+#include "protocol.h"
+#include "util.h"
+
+#define PROTOCOL_INFO_MS    1000
+#define PROTOCOL_DELIMITERS " \t\r\n"
+
+typedef struct Protocol
+{
+    tEngine *pEngine;
+    FILE *pOut;
+    pthread_mutex_t Mutex;
+    pthread_t Thread;
+    bool Searching;
+    atomic_bool Stop;
+    tProtocolRequest Request;
+    uint32_t Simulations;
+}
+tProtocol;
+
+static void protocol_stop(tProtocol *pProtocol);
+static void protocol_wait(tProtocol *pProtocol);
+static void *protocol_search_thread(void *pArg);
+static void protocol_print_file(void *pContext, const char *pLine);
+static void protocol_printf(tProtocolPrint Print, void *pContext, const char *pFormat, ...)
+    __attribute__((format(printf, 3, 4)));
+static int protocol_parse_number(char *pToken, uint32_t *pNumber);
+static double protocol_time_ms(struct timespec *pBegin, struct timespec *pEnd);
+
+/*
+ * Reads one command per line until "quit" or the end of the input:
+ *
+ *   position <rules> [<move> ...]      Sets the ruleset and the moves from the
+ *                                      start, keeping the tree if they continue
+ *                                      the current game
+ *   go [sims <n>] [movetime <ms>]      Searches n more simulations or for ms
+ *   go infinite                        milliseconds, or until "stop"
+ *   stop                               Ends the search
+ *   isready                            Answers "readyok"
+ *
+ * A search runs on its own thread and prints an "info" line about once a second
+ * and a "bestmove" line when it ends. Any other command waits for the search to
+ * end first. Invalid commands are answered with an "error" line.
+ */
+int protocol_run(FILE *pIn, FILE *pOut, const tEngineConfig *pConfig)
+{
+    int Res = 0;
+    tProtocol Protocol;
+    char Line[PROTOCOL_MAXLINE];
+
+    Res = engine_create(&Protocol.pEngine, pConfig);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
+    Protocol.pOut = pOut;
+    Protocol.Searching = false;
+    Protocol.Simulations = pConfig->Simulations;
+
+    pthread_mutex_init(&Protocol.Mutex, NULL);
+    atomic_init(&Protocol.Stop, false);
+
+    while (fgets(Line, sizeof(Line), pIn) ISNOT NULL)
+    {
+        tProtocolRequest Request;
+        int CommandRes = protocol_parse(Line, &Request);
+
+        if (Request.Command IS PROTOCOL_QUIT)
+        {
+            break;
+        }
+        else if (Request.Command IS PROTOCOL_STOP)
+        {
+            protocol_stop(&Protocol);
+        }
+        else if (Request.Command IS PROTOCOL_ISREADY)
+        {
+            protocol_printf(protocol_print_file, &Protocol, "readyok");
+        }
+        else if (Request.Command ISNOT PROTOCOL_NONE)
+        {
+            protocol_wait(&Protocol);
+
+            if (CommandRes == 0 AND Request.Command IS PROTOCOL_POSITION)
+            {
+                CommandRes = protocol_position(Protocol.pEngine, &Request);
+            }
+            else if (CommandRes == 0 AND Request.Command IS PROTOCOL_GO AND engine_finished(Protocol.pEngine))
+            {
+                CommandRes = -EINVAL;
+            }
+            else if (CommandRes == 0 AND Request.Command IS PROTOCOL_GO)
+            {
+                Protocol.Request = Request;
+                atomic_store(&Protocol.Stop, false);
+                engine_clear_stop(Protocol.pEngine);
+
+                CommandRes = -pthread_create(&Protocol.Thread, NULL, protocol_search_thread, &Protocol);
+                Protocol.Searching = CommandRes == 0;
+            }
+            else if (Request.Command IS PROTOCOL_UNKNOWN)
+            {
+                protocol_printf(protocol_print_file, &Protocol, "error unknown command %s", Request.pName);
+            }
+        }
+
+        if (CommandRes < 0)
+        {
+            protocol_printf(protocol_print_file, &Protocol, "error invalid %s", Request.pName);
+        }
+    }
+
+    protocol_stop(&Protocol);
+
+    pthread_mutex_destroy(&Protocol.Mutex);
+    engine_free(Protocol.pEngine);
+
+Error:
+    return Res;
+}
+
+/*
+ * Splits the line in place, so the request's name points into the line. The
+ * command is set even when its arguments are invalid.
+ */
+int protocol_parse(char *pLine, tProtocolRequest *pRequest)
+{
+    int Res = 0;
+    char *pSave = NULL, *pToken;
+    char *pCommand = strtok_r(pLine, PROTOCOL_DELIMITERS, &pSave);
+
+    memset(pRequest, 0, sizeof(tProtocolRequest));
+
+    if (pCommand IS NULL)
+    {
+        pRequest->Command = PROTOCOL_NONE;
+        goto Error;
+    }
+
+    pRequest->pName = pCommand;
+    pRequest->Command = IF (strcmp(pCommand, "position") == 0) THEN PROTOCOL_POSITION
+        ELSE IF (strcmp(pCommand, "go") == 0) THEN PROTOCOL_GO
+        ELSE IF (strcmp(pCommand, "stop") == 0) THEN PROTOCOL_STOP
+        ELSE IF (strcmp(pCommand, "isready") == 0) THEN PROTOCOL_ISREADY
+        ELSE IF (strcmp(pCommand, "quit") == 0) THEN PROTOCOL_QUIT
+        ELSE PROTOCOL_UNKNOWN;
+
+    if (pRequest->Command IS PROTOCOL_POSITION)
+    {
+        Res = protocol_parse_position(pSave, pRequest);
+    }
+    else if (pRequest->Command IS PROTOCOL_GO)
+    {
+        while ((pToken = strtok_r(NULL, PROTOCOL_DELIMITERS, &pSave)) ISNOT NULL)
+        {
+            if (strcmp(pToken, "sims") == 0)
+            {
+                Res = protocol_parse_number(strtok_r(NULL, PROTOCOL_DELIMITERS, &pSave), &pRequest->Simulations);
+            }
+            else if (strcmp(pToken, "movetime") == 0)
+            {
+                Res = protocol_parse_number(strtok_r(NULL, PROTOCOL_DELIMITERS, &pSave), &pRequest->TimeMs);
+            }
+            else if (strcmp(pToken, "infinite") == 0)
+            {
+                pRequest->Infinite = true;
+            }
+            else
+            {
+                Res = -EINVAL;
+            }
+
+            if (Res < 0)
+            {
+                goto Error;
+            }
+        }
+    }
+
+Error:
+    return Res;
+}
+
+/*
+ * Parses a ruleset followed by its moves, e.g. "1 d4 d5", into the request.
+ */
+int protocol_parse_position(char *pLine, tProtocolRequest *pRequest)
+{
+    int Res = 0;
+    uint32_t RulesType;
+    char *pSave = NULL, *pToken;
+
+    pRequest->Size = 0;
+
+    Res = protocol_parse_number(strtok_r(pLine, PROTOCOL_DELIMITERS, &pSave), &RulesType);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
+    pRequest->RulesType = RulesType;
+
+    while ((pToken = strtok_r(NULL, PROTOCOL_DELIMITERS, &pSave)) ISNOT NULL)
+    {
+        char (*pId)[BOARD_ID_STR_LEN] = (char (*)[BOARD_ID_STR_LEN]) pToken;
+
+        if (pRequest->Size == ROWS*COLUMNS OR strlen(pToken) ISNOT BOARD_ID_STR_LEN - 1 OR NOT board_id_valid(pId))
+        {
+            Res = -EINVAL;
+            goto Error;
+        }
+
+        pRequest->Moves[pRequest->Size++] = board_id_index(pId);
+    }
+
+Error:
+    return Res;
+}
+
+int protocol_position(tEngine *pEngine, const tProtocolRequest *pRequest)
+{
+    return engine_set_position(pEngine, pRequest->RulesType, pRequest->Moves, pRequest->Size);
+}
+
+/*
+ * Without a limit, the search runs for the given simulations, which count the
+ * visits kept from earlier moves as in the interactive game. The search is
+ * split into slices of about a second to print its progress, and ends early
+ * when a slice adds no simulations, which happens once the root is proven or
+ * when the move came from the endgame solver. If the search was stopped before
+ * it started, the best move is taken from the tree as it is.
+ */
+void protocol_search(tEngine *pEngine, const tProtocolRequest *pRequest, uint32_t Simulations, atomic_bool *pStop,
+    tProtocolPrint Print, void *pContext)
+{
+    tEngineBudget Slice;
+    tEngineStats Stats;
+    struct timespec Begin, Now;
+    uint32_t Start, Last;
+    double Elapsed = 0.0;
+    int Best;
+
+    engine_stats(pEngine, &Stats);
+    Start = Last = Stats.Simulations;
+
+    Slice.Simulations = IF (pRequest->Infinite OR (pRequest->Simulations == 0 AND pRequest->TimeMs > 0)) THEN TVISITS_MAX
+        ELSE IF (pRequest->Simulations > 0) THEN Start + pRequest->Simulations
+        ELSE Simulations;
+    Slice.Simulations = IF (Slice.Simulations > TVISITS_MAX OR Slice.Simulations < Start) THEN TVISITS_MAX ELSE Slice.Simulations;
+    Slice.Simulations = IF atomic_load(pStop) THEN Start ELSE Slice.Simulations;
+
+    clock_gettime(CLOCK_MONOTONIC, &Begin);
+
+    do
+    {
+        Slice.TimeMs = IF (pRequest->TimeMs > 0 AND pRequest->TimeMs - Elapsed < PROTOCOL_INFO_MS)
+            THEN pRequest->TimeMs - (uint32_t) Elapsed
+            ELSE PROTOCOL_INFO_MS;
+
+        Best = engine_search(pEngine, &Slice);
+
+        clock_gettime(CLOCK_MONOTONIC, &Now);
+        Elapsed = protocol_time_ms(&Begin, &Now);
+
+        if (Best < 0)
+        {
+            break;
+        }
+
+        engine_stats(pEngine, &Stats);
+
+        protocol_printf(Print, pContext, "info sims %u sps %.0f eval %.3f nodes %u depth %u time %.0f", Stats.Simulations,
+            IF (Elapsed > 0.0) THEN (Stats.Simulations - Start) * 1.0e3 / Elapsed ELSE 0.0, Stats.Eval, Stats.Nodes,
+            Stats.MaxDepth, Elapsed);
+
+        if (Stats.Simulations == Last)
+        {
+            break;
+        }
+
+        Last = Stats.Simulations;
+    }
+    while (NOT atomic_load(pStop) AND Stats.Simulations < Slice.Simulations
+        AND (pRequest->TimeMs == 0 OR Elapsed < pRequest->TimeMs));
+
+    if (Best >= 0)
+    {
+        char Id[BOARD_ID_STR_LEN];
+
+        board_index_id_to_buf(Best, Id, sizeof(Id));
+        protocol_printf(Print, pContext, "bestmove %s", Id);
+    }
+    else
+    {
+        protocol_printf(Print, pContext, "bestmove none");
+    }
+}
+
+static void protocol_stop(tProtocol *pProtocol)
+{
+    atomic_store(&pProtocol->Stop, true);
+    engine_stop(pProtocol->pEngine);
+    protocol_wait(pProtocol);
+}
+
+static void protocol_wait(tProtocol *pProtocol)
+{
+    if (pProtocol->Searching)
+    {
+        pthread_join(pProtocol->Thread, NULL);
+        pProtocol->Searching = false;
+    }
+}
+
+static void *protocol_search_thread(void *pArg)
+{
+    tProtocol *pProtocol = pArg;
+
+    protocol_search(pProtocol->pEngine, &pProtocol->Request, pProtocol->Simulations, &pProtocol->Stop,
+        protocol_print_file, pProtocol);
+
+    return NULL;
+}
+
+static void protocol_print_file(void *pContext, const char *pLine)
+{
+    tProtocol *pProtocol = pContext;
+
+    pthread_mutex_lock(&pProtocol->Mutex);
+
+    fprintf(pProtocol->pOut, "%s\n", pLine);
+    fflush(pProtocol->pOut);
+
+    pthread_mutex_unlock(&pProtocol->Mutex);
+}
+
+static void protocol_printf(tProtocolPrint Print, void *pContext, const char *pFormat, ...)
+{
+    char Line[PROTOCOL_MAXLINE];
+    va_list Args;
+
+    va_start(Args, pFormat);
+    vsnprintf(Line, sizeof(Line), pFormat, Args);
+    va_end(Args);
+
+    Print(pContext, Line);
+}
+
+static int protocol_parse_number(char *pToken, uint32_t *pNumber)
+{
+    int Res = 0;
+    char *pEnd;
+    unsigned long Number;
+
+    if (pToken IS NULL)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    errno = 0;
+    Number = strtoul(pToken, &pEnd, 10);
+
+    if (errno ISNOT 0 OR *pEnd ISNOT '\0' OR *pToken == '-' OR Number == 0 OR Number > UINT32_MAX)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    *pNumber = Number;
+
+Error:
+    return Res;
+}
+
+static double protocol_time_ms(struct timespec *pBegin, struct timespec *pEnd)
+{
+    return (pEnd->tv_sec * 1.0e3 + pEnd->tv_nsec / 1.0e6) - (pBegin->tv_sec * 1.0e3 + pBegin->tv_nsec / 1.0e6);
+}
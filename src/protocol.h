@@ -0,0 +1,48 @@
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "board.h"
+#include "engine.h"
+
+#define PROTOCOL_MAXLINE    512
+
+typedef enum ProtocolCommand
+{
+    PROTOCOL_NONE       = 0,
+    PROTOCOL_POSITION   = 1,
+    PROTOCOL_GO         = 2,
+    PROTOCOL_STOP       = 3,
+    PROTOCOL_ISREADY    = 4,
+    PROTOCOL_QUIT       = 5,
+    PROTOCOL_UNKNOWN    = 6,
+}
+eProtocolCommand;
+
+typedef struct ProtocolRequest
+{
+    eProtocolCommand Command;
+    const char *pName;
+    int RulesType;
+    int Moves[ROWS*COLUMNS];
+    int Size;
+    uint32_t Simulations;
+    uint32_t TimeMs;
+    bool Infinite;
+}
+tProtocolRequest;
+
+typedef void (*tProtocolPrint)(void *pContext, const char *pLine);
+
+int protocol_run(FILE *pIn, FILE *pOut, const tEngineConfig *pConfig);
+int protocol_parse(char *pLine, tProtocolRequest *pRequest);
+int protocol_parse_position(char *pLine, tProtocolRequest *pRequest);
+int protocol_position(tEngine *pEngine, const tProtocolRequest *pRequest);
+void protocol_search(tEngine *pEngine, const tProtocolRequest *pRequest, uint32_t Simulations, atomic_bool *pStop,
+    tProtocolPrint Print, void *pContext);
+
+#endif
@@ -0,0 +1,289 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "board.h"
+#include "debug.h"
+#include "mctn.h"
+#include "mctnlist.h"
+#include "reclaimer.h"
+#include "types.h"
+#include "util.h"
+
+#define RECLAIMER_NICE  10
+
+typedef struct ReclaimerItem
+{
+    tMctnList List;
+    tReclaimer *pOwner;
+}
+tReclaimerItem;
+
+typedef struct ReclaimerQueue
+{
+    tReclaimerItem *pItems;
+    uint32_t Size;
+    uint32_t Capacity;
+    uint32_t Users;
+    tReclaimer *pCurrent;
+    bool Stop;
+    pthread_t Thread;
+    pthread_mutex_t Mutex;
+    pthread_cond_t Cond;
+}
+tReclaimerQueue;
+
+static void reclaimer_push(tReclaimer *pReclaimer, tMctnList *pList);
+static void reclaimer_queue(tReclaimer *pReclaimer, tMctnList *pList);
+static void *reclaimer_run(void *pArg);
+
+/*
+ * ReclaimerLock serializes starting and joining the thread, so that a reclaimer
+ * created while the last one is being destroyed waits for the old thread to exit.
+ */
+static pthread_mutex_t ReclaimerLock = PTHREAD_MUTEX_INITIALIZER;
+static tReclaimerQueue ReclaimerQueue = {
+    .pItems = NULL,
+    .Size = 0,
+    .Capacity = 0,
+    .Users = 0,
+    .pCurrent = NULL,
+    .Stop = false,
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .Cond = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Discarded subtrees are either freed a few nodes at a time by the searching
+ * thread, or handed to a low priority thread that frees them while the search
+ * goes on. There is a single background thread for the whole process, started
+ * by the first background reclaimer and joined when the last one is destroyed,
+ * once every queued subtree has been freed.
+ */
+tReclaimer *reclaimer_create(bool Background)
+{
+    tReclaimer *pReclaimer = emalloc(sizeof(tReclaimer));
+
+    pReclaimer->pLists = NULL;
+    pReclaimer->Size = 0;
+    pReclaimer->Capacity = 0;
+    pReclaimer->Freed = 0;
+    pReclaimer->Background = Background;
+
+    if (Background)
+    {
+        pthread_mutex_lock(&ReclaimerLock);
+
+        if (ReclaimerQueue.Users == 0)
+        {
+            ReclaimerQueue.Stop = false;
+
+            if (pthread_create(&ReclaimerQueue.Thread, NULL, reclaimer_run, &ReclaimerQueue) != 0)
+            {
+                dbg_printf(DEBUG_LEVEL_WARN, "Cannot start reclaimer thread, freeing on the search thread");
+                pReclaimer->Background = false;
+            }
+        }
+
+        if (pReclaimer->Background)
+        {
+            ReclaimerQueue.Users++;
+        }
+
+        pthread_mutex_unlock(&ReclaimerLock);
+    }
+
+    return pReclaimer;
+}
+
+/*
+ * Subtrees still queued by a background reclaimer are left to the thread, which
+ * no longer credits them to it.
+ */
+void reclaimer_destroy(tReclaimer *pReclaimer)
+{
+    if (pReclaimer->Background)
+    {
+        pthread_mutex_lock(&ReclaimerLock);
+        pthread_mutex_lock(&ReclaimerQueue.Mutex);
+
+        for (uint32_t i = 0; i < ReclaimerQueue.Size; ++i)
+        {
+            if (ReclaimerQueue.pItems[i].pOwner == pReclaimer)
+            {
+                ReclaimerQueue.pItems[i].pOwner = NULL;
+            }
+        }
+
+        if (ReclaimerQueue.pCurrent == pReclaimer)
+        {
+            ReclaimerQueue.pCurrent = NULL;
+        }
+
+        if (--ReclaimerQueue.Users == 0)
+        {
+            ReclaimerQueue.Stop = true;
+            pthread_cond_signal(&ReclaimerQueue.Cond);
+        }
+
+        pthread_mutex_unlock(&ReclaimerQueue.Mutex);
+
+        if (ReclaimerQueue.Users == 0)
+        {
+            pthread_join(ReclaimerQueue.Thread, NULL);
+
+            free(ReclaimerQueue.pItems);
+            ReclaimerQueue.pItems = NULL;
+            ReclaimerQueue.Capacity = 0;
+        }
+
+        pthread_mutex_unlock(&ReclaimerLock);
+    }
+    else
+    {
+        reclaimer_step(pReclaimer, UINT32_MAX);
+    }
+
+    free(pReclaimer->pLists);
+    free(pReclaimer);
+}
+
+void reclaimer_discard(tReclaimer *pReclaimer, tMctnList *pList)
+{
+    if (pList->pItems IS NULL)
+    {
+        return;
+    }
+
+    if (pReclaimer->Background)
+    {
+        pthread_mutex_lock(&ReclaimerQueue.Mutex);
+        reclaimer_queue(pReclaimer, pList);
+        pthread_cond_signal(&ReclaimerQueue.Cond);
+        pthread_mutex_unlock(&ReclaimerQueue.Mutex);
+    }
+    else
+    {
+        reclaimer_push(pReclaimer, pList);
+    }
+}
+
+/*
+ * Returns how many nodes were freed since the last step, after freeing up to
+ * Count more nodes when there is no background thread to do it.
+ */
+uint32_t reclaimer_step(tReclaimer *pReclaimer, uint32_t Count)
+{
+    uint32_t Freed = 0;
+
+    if (pReclaimer->Background)
+    {
+        pthread_mutex_lock(&ReclaimerQueue.Mutex);
+        Freed = pReclaimer->Freed;
+        pReclaimer->Freed = 0;
+        pthread_mutex_unlock(&ReclaimerQueue.Mutex);
+    }
+    else
+    {
+        while (Freed < Count AND pReclaimer->Size > 0)
+        {
+            tMctnList List = pReclaimer->pLists[--pReclaimer->Size];
+
+            for (tIndex i = 0; i < mctnlist_size(&List); ++i)
+            {
+                reclaimer_push(pReclaimer, &mctnlist_get(&List, i)->Children);
+            }
+
+            Freed += mctnlist_size(&List);
+
+            free(List.pItems);
+        }
+    }
+
+    return Freed;
+}
+
+static void reclaimer_push(tReclaimer *pReclaimer, tMctnList *pList)
+{
+    if (pList->pItems IS NULL)
+    {
+        return;
+    }
+
+    if (pReclaimer->Size == pReclaimer->Capacity)
+    {
+        pReclaimer->Capacity = IF (pReclaimer->Capacity > 0) THEN 2 * pReclaimer->Capacity ELSE ROWS*COLUMNS;
+        pReclaimer->pLists = erealloc(pReclaimer->pLists, pReclaimer->Capacity * sizeof(tMctnList));
+    }
+
+    pReclaimer->pLists[pReclaimer->Size++] = *pList;
+}
+
+static void reclaimer_queue(tReclaimer *pReclaimer, tMctnList *pList)
+{
+    tReclaimerQueue *pQueue = &ReclaimerQueue;
+
+    if (pQueue->Size == pQueue->Capacity)
+    {
+        pQueue->Capacity = IF (pQueue->Capacity > 0) THEN 2 * pQueue->Capacity ELSE ROWS*COLUMNS;
+        pQueue->pItems = erealloc(pQueue->pItems, pQueue->Capacity * sizeof(tReclaimerItem));
+    }
+
+    pQueue->pItems[pQueue->Size].List = *pList;
+    pQueue->pItems[pQueue->Size].pOwner = pReclaimer;
+    pQueue->Size++;
+}
+
+static void *reclaimer_run(void *pArg)
+{
+    tReclaimerQueue *pQueue = pArg;
+
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, gettid(), RECLAIMER_NICE);
+#endif
+
+    pthread_mutex_lock(&pQueue->Mutex);
+
+    while (true)
+    {
+        while (pQueue->Size == 0 AND NOT pQueue->Stop)
+        {
+            pthread_cond_wait(&pQueue->Cond, &pQueue->Mutex);
+        }
+
+        if (pQueue->Size == 0)
+        {
+            break;
+        }
+
+        tReclaimerItem Item = pQueue->pItems[--pQueue->Size];
+
+        pQueue->pCurrent = Item.pOwner;
+
+        pthread_mutex_unlock(&pQueue->Mutex);
+
+        uint32_t Freed = mctnlist_free(&Item.List);
+
+        pthread_mutex_lock(&pQueue->Mutex);
+
+        if (pQueue->pCurrent ISNOT NULL)
+        {
+            pQueue->pCurrent->Freed += Freed;
+            pQueue->pCurrent = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&pQueue->Mutex);
+
+    return NULL;
+}
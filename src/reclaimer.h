@@ -0,0 +1,24 @@
+#ifndef __RECLAIMER_H__
+#define __RECLAIMER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mctnlist.h"
+
+typedef struct Reclaimer
+{
+    tMctnList *pLists;
+    uint32_t Size;
+    uint32_t Capacity;
+    uint32_t Freed;
+    bool Background;
+}
+tReclaimer;
+
+tReclaimer *reclaimer_create(bool Background);
+void reclaimer_destroy(tReclaimer *pReclaimer);
+void reclaimer_discard(tReclaimer *pReclaimer, tMctnList *pList);
+uint32_t reclaimer_step(tReclaimer *pReclaimer, uint32_t Count);
+
+#endif
@@ -0,0 +1,386 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bitutil.h"
+#include "board.h"
+#include "record.h"
+#include "rules.h"
+#include "types.h"
+#include "util.h"
+
+#define RECORD_HEADER_LEN   (sizeof(RECORD_MAGIC) - 1 + 1)
+#define RECORD_FIELDS_LEN   3
+#define RECORD_VARINT_LEN   5
+#define RECORD_SEARCH_LEN   (1 + ROWS*COLUMNS*(1 + RECORD_VARINT_LEN))
+
+static size_t record_search_encode(uint8_t *pBuffer, const tRecordSearch *pSearch);
+static int record_search_decode(const uint8_t *pData, size_t Left, tRecordSearch *pSearch);
+
+/*
+ * A file of records starts with "TTGR" and a version byte. Each record is the
+ * ruleset, the final score for X as a signed byte, the number of moves, and
+ * the index of every move, one byte each, so a full game takes 52 bytes.
+ *
+ * If the ruleset has RECORD_SEARCHES set, the moves are followed by the search
+ * before every move: the number of root moves, and for every root move its
+ * index and its visits as a LEB128 varint.
+ */
+int record_writer_open(tRecordWriter *pWriter, const char *pFile)
+{
+    int Res = 0;
+
+    pWriter->pFile = fopen(pFile, "wb");
+    if (pWriter->pFile IS NULL)
+    {
+        Res = -errno;
+        goto Error;
+    }
+
+    if (fwrite(RECORD_MAGIC, 1, RECORD_HEADER_LEN - 1, pWriter->pFile) ISNOT RECORD_HEADER_LEN - 1
+        OR fputc(RECORD_VERSION, pWriter->pFile) == EOF)
+    {
+        Res = -EIO;
+        fclose(pWriter->pFile);
+        pWriter->pFile = NULL;
+    }
+
+Error:
+    return Res;
+}
+
+int record_write(tRecordWriter *pWriter, eRulesType RulesType, const int *pMoves, int Size, tScore Score,
+    const tRecordSearch *pSearches)
+{
+    int Res = 0;
+    uint8_t Buffer[RECORD_FIELDS_LEN + ROWS*COLUMNS];
+    uint8_t Search[RECORD_SEARCH_LEN];
+
+    if (Size < 0 OR Size > ROWS*COLUMNS)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    Buffer[0] = RulesType | (IF (pSearches ISNOT NULL) THEN RECORD_SEARCHES ELSE 0);
+    Buffer[1] = (uint8_t) (int8_t) Score;
+    Buffer[2] = Size;
+
+    for (int i = 0; i < Size; ++i)
+    {
+        if (NOT board_index_valid(pMoves[i]) OR (pSearches ISNOT NULL AND pSearches[i].Size > ROWS*COLUMNS))
+        {
+            Res = -EINVAL;
+            goto Error;
+        }
+
+        Buffer[RECORD_FIELDS_LEN + i] = pMoves[i];
+    }
+
+    if (fwrite(Buffer, 1, RECORD_FIELDS_LEN + Size, pWriter->pFile) ISNOT (size_t) (RECORD_FIELDS_LEN + Size))
+    {
+        Res = -EIO;
+        goto Error;
+    }
+
+    for (int i = 0; pSearches ISNOT NULL AND i < Size; ++i)
+    {
+        size_t Length = record_search_encode(Search, &pSearches[i]);
+
+        if (fwrite(Search, 1, Length, pWriter->pFile) ISNOT Length)
+        {
+            Res = -EIO;
+            goto Error;
+        }
+    }
+
+Error:
+    return Res;
+}
+
+int record_writer_close(tRecordWriter *pWriter)
+{
+    int Res = 0;
+
+    if (fclose(pWriter->pFile) ISNOT 0)
+    {
+        Res = -errno;
+    }
+
+    pWriter->pFile = NULL;
+
+    return Res;
+}
+
+int record_reader_open(tRecordReader *pReader, const char *pFile)
+{
+    int Res = 0, Fd;
+    struct stat Stat;
+    void *pMap;
+
+    pReader->pMap = NULL;
+    pReader->Size = 0;
+    pReader->Offset = RECORD_HEADER_LEN;
+
+    Fd = open(pFile, O_RDONLY);
+    if (Fd < 0)
+    {
+        Res = -errno;
+        goto Error;
+    }
+
+    if (fstat(Fd, &Stat) < 0 OR Stat.st_size < (off_t) RECORD_HEADER_LEN)
+    {
+        Res = -EINVAL;
+        goto Close;
+    }
+
+    pMap = mmap(NULL, Stat.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        Res = -errno;
+        goto Close;
+    }
+
+    pReader->pMap = pMap;
+    pReader->Size = Stat.st_size;
+
+    if (memcmp(pReader->pMap, RECORD_MAGIC, RECORD_HEADER_LEN - 1) ISNOT 0
+        OR pReader->pMap[RECORD_HEADER_LEN - 1] ISNOT RECORD_VERSION)
+    {
+        Res = -EINVAL;
+        record_reader_close(pReader);
+        goto Close;
+    }
+
+    madvise(pMap, pReader->Size, MADV_SEQUENTIAL);
+
+Close:
+    close(Fd);
+
+Error:
+    return Res;
+}
+
+/*
+ * Returns 0 and the next record, -ENODATA at the end of the file, or -EINVAL
+ * if the file ends in the middle of a record.
+ */
+int record_next(tRecordReader *pReader, tRecord *pRecord)
+{
+    int Res = 0;
+    const uint8_t *pFields = pReader->pMap + pReader->Offset;
+    size_t Left = pReader->Size - pReader->Offset;
+
+    if (Left == 0)
+    {
+        Res = -ENODATA;
+        goto Error;
+    }
+
+    if (Left < RECORD_FIELDS_LEN OR Left < (size_t) RECORD_FIELDS_LEN + pFields[2])
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    pRecord->RulesType = pFields[0] & ~RECORD_SEARCHES;
+    pRecord->Score = (int8_t) pFields[1];
+    pRecord->Size = pFields[2];
+    pRecord->pMoves = pFields + RECORD_FIELDS_LEN;
+    pRecord->pSearches = NULL;
+    pRecord->SearchesLength = 0;
+
+    if (pFields[0] & RECORD_SEARCHES)
+    {
+        const uint8_t *pSearches = pRecord->pMoves + pRecord->Size;
+        size_t Length = 0;
+
+        Left -= RECORD_FIELDS_LEN + pRecord->Size;
+
+        for (tSize i = 0; i < pRecord->Size; ++i)
+        {
+            Res = record_search_decode(pSearches + Length, Left - Length, NULL);
+            if (Res < 0)
+            {
+                goto Error;
+            }
+
+            Length += Res;
+        }
+
+        Res = 0;
+        pRecord->pSearches = pSearches;
+        pRecord->SearchesLength = Length;
+    }
+
+    pReader->Offset += RECORD_FIELDS_LEN + pRecord->Size + pRecord->SearchesLength;
+
+Error:
+    return Res;
+}
+
+/*
+ * Decodes the search before the next move, starting at *pOffset, which the
+ * caller sets to 0 before the first move. Returns -ENODATA if the record has no
+ * searches or all of them were read.
+ */
+int record_search(const tRecord *pRecord, size_t *pOffset, tRecordSearch *pSearch)
+{
+    int Res = -ENODATA;
+
+    if (*pOffset < pRecord->SearchesLength)
+    {
+        Res = record_search_decode(pRecord->pSearches + *pOffset, pRecord->SearchesLength - *pOffset, pSearch);
+    }
+
+    if (Res > 0)
+    {
+        *pOffset += Res;
+        Res = 0;
+    }
+
+    return Res;
+}
+
+void record_reader_close(tRecordReader *pReader)
+{
+    if (pReader->pMap ISNOT NULL)
+    {
+        munmap((void *) pReader->pMap, pReader->Size);
+    }
+
+    pReader->pMap = NULL;
+    pReader->Size = 0;
+}
+
+/*
+ * Plays the record's moves on a new board, checking each against the ruleset.
+ */
+int record_replay(const tRecord *pRecord, tBoard *pBoard)
+{
+    int Res = 0;
+    tRulesConfig Config;
+    tRules Rules;
+
+    if (pRecord->RulesType < RULES_CLASSICAL OR pRecord->RulesType > RULES_MALLORCAN OR pRecord->Size > ROWS*COLUMNS)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    Config.RulesType = pRecord->RulesType;
+    rules_init(&Rules, &Config);
+    board_init(pBoard);
+
+    for (tSize i = 0; i < pRecord->Size; ++i)
+    {
+        tIndex Index = pRecord->pMoves[i];
+
+        if (NOT board_index_valid(Index) OR NOT BitTest64(rules_indices(&Rules, pBoard, false), Index))
+        {
+            Res = -EINVAL;
+            goto Error;
+        }
+
+        board_advance(pBoard, Index, rules_player(&Rules, pBoard));
+    }
+
+Error:
+    return Res;
+}
+
+static size_t record_search_encode(uint8_t *pBuffer, const tRecordSearch *pSearch)
+{
+    size_t Length = 0;
+
+    pBuffer[Length++] = pSearch->Size;
+
+    for (tSize i = 0; i < pSearch->Size; ++i)
+    {
+        uint32_t Visits = pSearch->Visits[i];
+
+        pBuffer[Length++] = pSearch->Indices[i];
+
+        while (Visits >= 0x80)
+        {
+            pBuffer[Length++] = (Visits & 0x7F) | 0x80;
+            Visits >>= 7;
+        }
+
+        pBuffer[Length++] = Visits;
+    }
+
+    return Length;
+}
+
+/*
+ * Returns the length of the search at pData, or -EINVAL if it runs past Left
+ * bytes. pSearch may be NULL to only skip it.
+ */
+static int record_search_decode(const uint8_t *pData, size_t Left, tRecordSearch *pSearch)
+{
+    int Res = 0;
+    size_t Length = 1;
+    tSize Size;
+
+    if (Left < 1 OR pData[0] > ROWS*COLUMNS)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    Size = pData[0];
+
+    for (tSize i = 0; i < Size; ++i)
+    {
+        uint32_t Visits = 0;
+        int Shift = 0;
+
+        if (Length >= Left)
+        {
+            Res = -EINVAL;
+            goto Error;
+        }
+
+        if (pSearch ISNOT NULL)
+        {
+            pSearch->Indices[i] = pData[Length];
+        }
+
+        Length++;
+
+        do
+        {
+            if (Length >= Left OR Shift >= 7*RECORD_VARINT_LEN)
+            {
+                Res = -EINVAL;
+                goto Error;
+            }
+
+            Visits |= (uint32_t) (pData[Length] & 0x7F) << Shift;
+            Shift += 7;
+        }
+        while (pData[Length++] & 0x80);
+
+        if (pSearch ISNOT NULL)
+        {
+            pSearch->Visits[i] = Visits;
+        }
+    }
+
+    if (pSearch ISNOT NULL)
+    {
+        pSearch->Size = Size;
+    }
+
+    Res = Length;
+
+Error:
+    return Res;
+}
@@ -0,0 +1,67 @@
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "board.h"
+#include "rules.h"
+#include "types.h"
+
+#define RECORD_MAGIC    "TTGR"
+#define RECORD_VERSION  1
+#define RECORD_SEARCHES 0x80
+
+/*
+ * The root moves searched before a move was played, with their visits. Moves
+ * played without a search have none.
+ */
+typedef struct RecordSearch
+{
+    tSize Size;
+    tIndex Indices[ROWS*COLUMNS];
+    uint32_t Visits[ROWS*COLUMNS];
+}
+tRecordSearch;
+
+/*
+ * A record in a mapped file. The moves point into the mapping and are only
+ * valid until the reader is closed.
+ */
+typedef struct Record
+{
+    eRulesType RulesType;
+    tScore Score;
+    tSize Size;
+    const uint8_t *pMoves;
+    const uint8_t *pSearches;
+    size_t SearchesLength;
+}
+tRecord;
+
+typedef struct RecordWriter
+{
+    FILE *pFile;
+}
+tRecordWriter;
+
+typedef struct RecordReader
+{
+    const uint8_t *pMap;
+    size_t Size;
+    size_t Offset;
+}
+tRecordReader;
+
+int record_writer_open(tRecordWriter *pWriter, const char *pFile);
+int record_write(tRecordWriter *pWriter, eRulesType RulesType, const int *pMoves, int Size, tScore Score,
+    const tRecordSearch *pSearches);
+int record_writer_close(tRecordWriter *pWriter);
+int record_reader_open(tRecordReader *pReader, const char *pFile);
+int record_next(tRecordReader *pReader, tRecord *pRecord);
+int record_search(const tRecord *pRecord, size_t *pOffset, tRecordSearch *pSearch);
+void record_reader_close(tRecordReader *pReader);
+int record_replay(const tRecord *pRecord, tBoard *pBoard);
+
+#endif
@@ -86,20 +86,45 @@ void rules_simulate_playout(tRules *pRules, tBoard *pBoard, tRandom *pRandom, bo
 
 char *rules_moves_string(tRules *pRules, int *pMoves, int Size)
 {
-    char *Str = emalloc(RULES_MOVES_STR_LEN * sizeof(char)), *pBegin = Str;
+    char *Str = emalloc(RULES_MOVES_STR_LEN * sizeof(char));
+
+    rules_moves_string_to_buf(pRules, pMoves, Size, Str, RULES_MOVES_STR_LEN);
+
+    return Str;
+}
+
+/*
+ * Writes the moves into the buffer, numbered and three to a line, and returns
+ * the length written, -EINVAL for an invalid move or -ENOSPC if the buffer is
+ * too small. A buffer of RULES_MOVES_STR_LEN holds a whole game.
+ */
+int rules_moves_string_to_buf(tRules *pRules, int *pMoves, int Size, char *pBuf, size_t Cap)
+{
+    int Res = 0;
+    size_t Length = 0;
     tSize Move = 1;
     bool StartedMove = false;
 
+    if (Cap > 0)
+    {
+        pBuf[0] = '\0';
+    }
+
     for (tIndex i = 0; i < Size; ++i)
     {
-        tIndex Index = pMoves[i];
-        char *pId = board_index_id(Index);
+        char Id[BOARD_ID_STR_LEN];
+
+        Res = board_index_id_to_buf(pMoves[i], Id, sizeof(Id));
+        if (Res < 0)
+        {
+            goto Error;
+        }
 
         if (rules_index_player(pRules, i) AND NOT StartedMove)
         {
             char *MoveFmt = IF (Move < 10) THEN " %d. %s " ELSE "%d. %s ";
             
-            Str += sprintf(Str, MoveFmt, Move, pId);
+            Res = bprintf(pBuf, Cap, &Length, MoveFmt, Move, Id);
             Move++;
             StartedMove = true;
         }
@@ -107,24 +132,28 @@ char *rules_moves_string(tRules *pRules, int *pMoves, int Size)
         {
             if (NOT rules_index_player(pRules, i) AND (i+1 < Size) AND rules_index_player(pRules, i+1)) 
             {
-                Str += sprintf(Str, "%s  ", pId); 
+                Res = bprintf(pBuf, Cap, &Length, "%s  ", Id); 
                 StartedMove = false;
 
-                if ((Move-1) % 3 == 0)
+                if (Res == 0 AND (Move-1) % 3 == 0)
                 {
-                    Str += sprintf(Str, "\n");
+                    Res = bprintf(pBuf, Cap, &Length, "\n");
                 }  
             }
             else 
             {
-                Str += sprintf(Str, "%s ", pId); 
+                Res = bprintf(pBuf, Cap, &Length, "%s ", Id); 
             }
         }
 
-        free(pId);
+        if (Res < 0)
+        {
+            goto Error;
+        }
     }
 
-    return pBegin;
+Error:
+    return IF (Res < 0) THEN Res ELSE (int) Length;
 }
 
 static uint64_t rules_policy(tRules *pRules, tBoard *pBoard)
@@ -2,6 +2,7 @@
 #define __RULES_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "board.h"
@@ -67,6 +68,7 @@ bool rules_prev_player(tRules *pRules, tBoard *pState);
 void rules_simulate_playout(tRules *pRules, tBoard *pBoard, tRandom *pRandom, bool OnlyNeighbors);
 tBoard *rules_next_states(tRules *pRules, tBoard *pBoard, tSize *pSize, bool OnlyNeighbors);
 char *rules_moves_string(tRules *pRules, int *pMoves, int Size);
+int rules_moves_string_to_buf(tRules *pRules, int *pMoves, int Size, char *pBuf, size_t Cap);
 
 static const eMovePolicy RulesClassical[ROWS*COLUMNS] = 
 {
@@ -5,6 +5,7 @@
 #include "bitutil.h"
 #include "board.h"
 #include "debug.h"
+#include "pathfinder.h"
 #include "scorer.h"
 #include "types.h"
 #include "util.h"
@@ -18,6 +19,10 @@
 #define AREA_3X4_EXITS          7
 #define AREA_3X4_MASK           0x0FFFU
 #define AREA_3X4_LOOKUP_SIZE    4096
+#define AREA_3X4_NIBBLES        3
+#define AREA_3X4_NIBBLE_SIZE    16
+
+#define AREA_3X4_MEMO_SIZE      16
 
 #define AREA_3x4_MASK_00_02     0x0007U
 #define AREA_3x4_MASK_03_05     0x0038U
@@ -29,6 +34,7 @@
 #define AREA_3x4_MASK_08_11     0x0F00U
 
 #define BOARD_QUADRANTS     4
+#define BOARD_CENTER_INDEX  24
 #define BOARD_Q1_MASK       0x000000000003C78FULL
 #define BOARD_Q2_MASK       0x000000000E1C3870ULL
 #define BOARD_Q3_MASK       0x0001E3C780000000ULL
@@ -43,14 +49,16 @@ tArea3x4Path;
 
 typedef struct Area3x4PathLookup
 {
-    tVector Paths;
+    uint32_t Paths;
+    tSize PathCount;
     tIndex Exit;
 }
 tArea3x4PathLookup;
 
 typedef struct Area3x4IndexLookup
 {
-    tVector Exits;
+    uint32_t Exits;
+    tSize ExitCount;
     tSize LongestPath;
     uint16_t Area;
 }
@@ -62,6 +70,14 @@ typedef struct Area3x4Lookup
 }
 tArea3x4Lookup;
 
+typedef struct Area3x4Memo
+{
+    uint64_t Data;
+    tIndex Index;
+    tSize Length;
+}
+tArea3x4Memo;
+
 typedef struct Area3x4AjacentIndexLookup
 {
     bool LeftValid, RightValid, TopValid, BottomValid;
@@ -69,15 +85,21 @@ typedef struct Area3x4AjacentIndexLookup
 }
 tArea3x4AdjacentIndexLookup;
 
-static const tIndex BoardAreaExitIndicesQ0[AREA_1X1_EXITS] = { 17, 25, 31, 23 };
-static const tIndex BoardAreaExitIndicesQ1[AREA_3X4_EXITS] = {  4, 11, 18, 21, 22, 23, 24 };
-static const tIndex BoardAreaExitIndicesQ2[AREA_3X4_EXITS] = { 34, 33, 32,  3, 10, 17, 24 };
-static const tIndex BoardAreaExitIndicesQ3[AREA_3X4_EXITS] = { 44, 37, 30, 27, 26, 25, 24 };
-static const tIndex BoardAreaExitIndicesQ4[AREA_3X4_EXITS] = { 14, 15, 16, 45, 38, 31, 24 };
+static const tIndex BoardAreaExitIndices[BOARD_QUADRANTS+1][AREA_3X4_EXITS] = {
+    {  4, 11, 18, 21, 22, 23, 24 },
+    { 34, 33, 32,  3, 10, 17, 24 },
+    { 44, 37, 30, 27, 26, 25, 24 },
+    { 14, 15, 16, 45, 38, 31, 24 },
+    { 17, 25, 31, 23 },
+};
 
 static tArea3x4Lookup Area3x4Lookup[AREA_3X4_LOOKUP_SIZE] = { 0 };
-static uint64_t Area3x4ExpansionLookup[BOARD_QUADRANTS][AREA_3X4_LOOKUP_SIZE] = { 0 };
-static uint16_t Area3x4RotationLookup[BOARD_QUADRANTS][AREA_3X4_LOOKUP_SIZE] = { 0 };
+static tArea3x4PathLookup *pArea3x4ExitLookup = NULL;
+static tArea3x4Path *pArea3x4PathLookup = NULL;
+static uint32_t Area3x4ExitLookupSize = 0U, Area3x4ExitLookupCapacity = 0U;
+static uint32_t Area3x4PathLookupSize = 0U, Area3x4PathLookupCapacity = 0U;
+static uint64_t Area3x4ExpansionLookup[BOARD_QUADRANTS][AREA_3X4_NIBBLES][AREA_3X4_NIBBLE_SIZE] = { 0 };
+static uint16_t Area3x4RotationLookup[BOARD_QUADRANTS][AREA_3X4_NIBBLES][AREA_3X4_NIBBLE_SIZE] = { 0 };
 
 static const tIndex Area3x4IndexLookup[ROWS*COLUMNS] = {
     0,  1,  2,  3,  8,  4,  0,
@@ -95,7 +117,7 @@ static const tIndex Area3x4QuadrantLookup[ROWS*COLUMNS] = {
     0, 0, 0, 0, 1, 1, 1,
     0, 0, 0, 0, 1, 1, 1,
     0, 0, 0, 0, 1, 1, 1, 
-    3, 3, 3, 0, 1, 1, 1,
+    3, 3, 3, 4, 1, 1, 1,
     3, 3, 3, 2, 2, 2, 2,
     3, 3, 3, 2, 2, 2, 2,
     3, 3, 3, 2, 2, 2, 2,
@@ -132,7 +154,9 @@ static const tArea3x4AdjacentIndexLookup Area3x4AdjacentIndexLookup[AREA_3X4_IND
 
 static tSize area_3x4_lookup_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea);
 static tSize area_1x1_lookup_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea);
+static tSize area_3x4_memo_longest_path(tArea3x4Memo *pMemo, tSize *pMemoSize, uint64_t Data, tIndex Index, uint64_t *pArea);
 
+static void area_3x4_add_exit(tArea3x4IndexLookup *pIndexLookup, tIndex Exit, tVector *pPaths);
 static void area_3x4_get_paths(uint16_t Data, tIndex Start, tIndex End, uint16_t Path, tVector *pVector);
 static void area_3x4_filter_paths(uint16_t Data, uint16_t MaxPath, tVector *pPaths);
 
@@ -147,12 +171,6 @@ static tSize area_3x4_longest_exit_path(uint16_t Data);
 static bool area_3x4_subpath(uint16_t Data, uint16_t Path);
 static bool area_3x4_subpath_has_longer_through_path(uint16_t Area, uint16_t Path, uint16_t SubPath);
 
-static tIndex board_area_exit_index_q0(tIndex Index);
-static tIndex board_area_exit_index_q1(tIndex Index);
-static tIndex board_area_exit_index_q2(tIndex Index);
-static tIndex board_area_exit_index_q3(tIndex Index);
-static tIndex board_area_exit_index_q4(tIndex Index);
-
 static uint64_t area_3x4_expand_q1(uint16_t Data);
 static uint64_t area_3x4_expand_q2(uint16_t Data);
 static uint64_t area_3x4_expand_q3(uint16_t Data);
@@ -163,41 +181,18 @@ static uint16_t area_3x4_contract_q2(uint64_t Data);
 static uint16_t area_3x4_contract_q3(uint64_t Data);
 static uint16_t area_3x4_contract_q4(uint64_t Data);
 
-static const tSize (*board_area_lookup_longest_path[ROWS*COLUMNS])(uint64_t, tIndex, uint64_t *) = {
-    area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path,
-    area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path,
-    area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path,
-    area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_1x1_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path,
-    area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path,
-    area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path,
-    area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path, area_3x4_lookup_longest_path,
-};
+static uint64_t area_3x4_expand(uint16_t Data, tIndex Quadrant);
+static uint16_t area_3x4_rotate(uint64_t Data, tIndex Quadrant);
+static uint64_t area_3x4_expand_q(uint16_t Data, tIndex Quadrant);
+static uint16_t area_3x4_contract_q(uint64_t Data, tIndex Quadrant);
 
-static const tIndex (*board_area_exit_index_q[ROWS*COLUMNS])(tIndex) = {
-    board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q2, board_area_exit_index_q2, board_area_exit_index_q2,
-    board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q2, board_area_exit_index_q2, board_area_exit_index_q2,
-    board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q1, board_area_exit_index_q2, board_area_exit_index_q2, board_area_exit_index_q2,
-    board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q0, board_area_exit_index_q2, board_area_exit_index_q2, board_area_exit_index_q2,
-    board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q3, board_area_exit_index_q3, board_area_exit_index_q3, board_area_exit_index_q3,
-    board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q3, board_area_exit_index_q3, board_area_exit_index_q3, board_area_exit_index_q3,
-    board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q4, board_area_exit_index_q3, board_area_exit_index_q3, board_area_exit_index_q3, board_area_exit_index_q3,
-};
-
-static const uint16_t (*area_3x4_contract_q[ROWS*COLUMNS])(uint64_t) = {
-    area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q2, area_3x4_contract_q2, area_3x4_contract_q2,
-    area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q2, area_3x4_contract_q2, area_3x4_contract_q2,
-    area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q1, area_3x4_contract_q2, area_3x4_contract_q2, area_3x4_contract_q2,
-    area_3x4_contract_q4, area_3x4_contract_q4, area_3x4_contract_q4,                 NULL, area_3x4_contract_q2, area_3x4_contract_q2, area_3x4_contract_q2,
-    area_3x4_contract_q4, area_3x4_contract_q4, area_3x4_contract_q4, area_3x4_contract_q3, area_3x4_contract_q3, area_3x4_contract_q3, area_3x4_contract_q3,
-    area_3x4_contract_q4, area_3x4_contract_q4, area_3x4_contract_q4, area_3x4_contract_q3, area_3x4_contract_q3, area_3x4_contract_q3, area_3x4_contract_q3,
-    area_3x4_contract_q4, area_3x4_contract_q4, area_3x4_contract_q4, area_3x4_contract_q3, area_3x4_contract_q3, area_3x4_contract_q3, area_3x4_contract_q3,
-};
-
-#define BOARD_AREA_LONGEST_PATH(Data, Index, pArea)     ((*board_area_lookup_longest_path[Index])(Data, Index, pArea))
-#define BOARD_AREA_EXIT_INDEX_Q(Index, Exit)            ((*board_area_exit_index_q[Index])(Exit))
+#define BOARD_AREA_LONGEST_PATH(Data, Index, pArea)     (IF ((Index) == BOARD_CENTER_INDEX) \
+    THEN area_1x1_lookup_longest_path(Data, Index, pArea) \
+    ELSE area_3x4_lookup_longest_path(Data, Index, pArea))
+#define BOARD_AREA_EXIT_INDEX_Q(Index, Exit)            (BoardAreaExitIndices[AREA_3X4_QUADRANT(Index)][Exit])
 
-#define AREA_3X4_EXPAND_Q(Data, Index)      (Area3x4ExpansionLookup[AREA_3X4_QUADRANT(Index)][Data])
-#define AREA_3X4_ROTATE_Q(Data, Index)      (Area3x4RotationLookup[AREA_3X4_QUADRANT(Index)][(*area_3x4_contract_q[Index])(Data)])
+#define AREA_3X4_EXPAND_Q(Data, Index)      (area_3x4_expand(Data, AREA_3X4_QUADRANT(Index)))
+#define AREA_3X4_ROTATE_Q(Data, Index)      (area_3x4_rotate(Data, AREA_3X4_QUADRANT(Index)))
 
 void scorer_init()
 {
@@ -217,8 +212,8 @@ void scorer_init()
             {
                 uint16_t Area = area_3x4_area(Data, Start);
 
-                vector_init(&pIndexLookup->Exits);
-
+                pIndexLookup->Exits = Area3x4ExitLookupSize;
+                pIndexLookup->ExitCount = 0;
                 pIndexLookup->LongestPath = area_3x4_index_longest_path(Area, Start);
                 pIndexLookup->Area = Area;
 
@@ -230,44 +225,48 @@ void scorer_init()
 
                     if (BitTest16(Area, End) AND area_3x4_longest_path(Area, Start, End, &MaxLength, &MaxPath))
                     {
-                        tArea3x4PathLookup *pPathLookup = emalloc(sizeof(tArea3x4PathLookup));
-                        tVector *pPaths = &pPathLookup->Paths;
-
-                        vector_init(pPaths);
-                        area_3x4_get_paths(Area, Start, End, 0U, pPaths);
-                        area_3x4_filter_paths(Area, MaxPath, pPaths);
+                        tVector Paths;
 
-                        pPathLookup->Exit = Exit;
+                        vector_init(&Paths);
+                        area_3x4_get_paths(Area, Start, End, 0U, &Paths);
+                        area_3x4_filter_paths(Area, MaxPath, &Paths);
 
-                        vector_add(&pIndexLookup->Exits, pPathLookup);
+                        TotalPaths += vector_size(&Paths);
 
-                        TotalPaths += vector_size(pPaths);
+                        area_3x4_add_exit(pIndexLookup, Exit, &Paths);
                     }
                 }
             }
         }
 
-        uint64_t Expansion1 = area_3x4_expand_q1(Data);
-        uint64_t Expansion2 = area_3x4_expand_q2(Data);
-        uint64_t Expansion3 = area_3x4_expand_q3(Data);
-        uint64_t Expansion4 = area_3x4_expand_q4(Data);
+        for (tIndex Quadrant = 0; Quadrant < BOARD_QUADRANTS; ++Quadrant)
+        {
+            uint64_t Expansion = area_3x4_expand_q(Data, Quadrant);
+            uint16_t Contraction = area_3x4_contract_q(Expansion, Quadrant);
 
-        uint16_t Contraction1 = area_3x4_contract_q1(Expansion1);
-        uint16_t Contraction2 = area_3x4_contract_q2(Expansion2);
-        uint16_t Contraction3 = area_3x4_contract_q3(Expansion3);
-        uint16_t Contraction4 = area_3x4_contract_q4(Expansion4);
+            for (tIndex Nibble = 0; Nibble < AREA_3X4_NIBBLES; ++Nibble)
+            {
+                tIndex Shift = Nibble * 4;
 
-        Area3x4ExpansionLookup[0][Data] = Expansion1;
-        Area3x4ExpansionLookup[1][Data] = Expansion2;
-        Area3x4ExpansionLookup[2][Data] = Expansion3;
-        Area3x4ExpansionLookup[3][Data] = Expansion4;
+                if ((Data & ~((AREA_3X4_NIBBLE_SIZE - 1) << Shift)) == 0U)
+                {
+                    Area3x4ExpansionLookup[Quadrant][Nibble][Data >> Shift] = Expansion;
+                }
 
-        Area3x4RotationLookup[0][Contraction1] = Data;
-        Area3x4RotationLookup[1][Contraction2] = Data;
-        Area3x4RotationLookup[2][Contraction3] = Data;
-        Area3x4RotationLookup[3][Contraction4] = Data;
+                if ((Contraction & ~((AREA_3X4_NIBBLE_SIZE - 1) << Shift)) == 0U)
+                {
+                    Area3x4RotationLookup[Quadrant][Nibble][Contraction >> Shift] = Data;
+                }
+            }
+        }
     }
 
+    Area3x4ExitLookupCapacity = Area3x4ExitLookupSize;
+    Area3x4PathLookupCapacity = Area3x4PathLookupSize;
+
+    pArea3x4ExitLookup = erealloc(pArea3x4ExitLookup, Area3x4ExitLookupCapacity * sizeof(tArea3x4PathLookup));
+    pArea3x4PathLookup = erealloc(pArea3x4PathLookup, Area3x4PathLookupCapacity * sizeof(tArea3x4Path));
+
     dbg_printf(DEBUG_LEVEL_INFO, "Initialized scorer lookup with %d paths", TotalPaths);
 }
 
@@ -275,37 +274,14 @@ void scorer_free()
 {
     dbg_printf(DEBUG_LEVEL_INFO, "Disposing scorer lookup");
 
-    for (uint16_t Data = 0; Data < AREA_3X4_LOOKUP_SIZE; ++Data)
-    {
-        tArea3x4Lookup *pLookup = &Area3x4Lookup[Data];
-
-        for (tIndex i = 0; i < AREA_3X4_INDICES; ++i)
-        {
-            tArea3x4IndexLookup *pIndexLookup = &pLookup->Indices[i];
-            tVectorIterator ExitsIterator;
-
-            vector_iterator_init(&ExitsIterator, &pIndexLookup->Exits);
+    free(pArea3x4ExitLookup);
+    free(pArea3x4PathLookup);
 
-            while (vector_iterator_has_next(&ExitsIterator))
-            {
-                tArea3x4PathLookup *pPaths = vector_iterator_next(&ExitsIterator);
-                tVectorIterator PathsIterator;
-
-                vector_iterator_init(&PathsIterator, &pPaths->Paths);
-
-                while (vector_iterator_has_next(&PathsIterator))
-                {
-                    tArea3x4Path *pPath = vector_iterator_next(&PathsIterator);
-                    free(pPath);
-                }
+    pArea3x4ExitLookup = NULL;
+    pArea3x4PathLookup = NULL;
 
-                vector_free(&pPaths->Paths);
-                free(pPaths);
-            }
-
-            vector_free(&pIndexLookup->Exits);
-        }
-    }
+    Area3x4ExitLookupSize = Area3x4ExitLookupCapacity = 0U;
+    Area3x4PathLookupSize = Area3x4PathLookupCapacity = 0U;
 
     dbg_printf(DEBUG_LEVEL_INFO, "Disposed scorer lookup");
 }
@@ -319,34 +295,30 @@ static tSize area_3x4_lookup_longest_path(uint64_t Data, tIndex Index, uint64_t
 {
     tArea3x4Lookup *pLookup = &Area3x4Lookup[AREA_3X4_ROTATE_Q(Data, Index)];
     tArea3x4IndexLookup *pIndexLookup = &pLookup->Indices[AREA_3X4_INDEX(Index)];
-    tSize MaxPathLength = 0;
+    tArea3x4Memo Memo[AREA_3X4_MEMO_SIZE];
+    tSize MaxPathLength = 0, MemoSize = 0;
 
     *pArea |= AREA_3X4_EXPAND_Q(pIndexLookup->Area, Index);
 
     SET_IF_GREATER(pIndexLookup->LongestPath, MaxPathLength);
 
-    tVector *pExitLookup = &pIndexLookup->Exits;
-    tVectorIterator ExitsIterator;
-
-    vector_iterator_init(&ExitsIterator, pExitLookup);
+    tArea3x4PathLookup *pPathLookup = &pArea3x4ExitLookup[pIndexLookup->Exits];
 
-    while (vector_iterator_has_next(&ExitsIterator))
+    for (tSize e = 0; e < pIndexLookup->ExitCount; ++e, ++pPathLookup)
     {
-        tArea3x4PathLookup *pPathLookup = vector_iterator_next(&ExitsIterator);
         tIndex NextIndex = BOARD_AREA_EXIT_INDEX_Q(Index, pPathLookup->Exit);
 
         if (BitTest64(Data, NextIndex))
         {
-            tVector *pPaths = &pPathLookup->Paths;
-            tVectorIterator PathsIterator;
+            tArea3x4Path *pPath = &pArea3x4PathLookup[pPathLookup->Paths];
+            bool Memoize = pPathLookup->PathCount > 1;
 
-            vector_iterator_init(&PathsIterator, pPaths);
-
-            while (vector_iterator_has_next(&PathsIterator))
+            for (tSize p = 0; p < pPathLookup->PathCount; ++p, ++pPath)
             {
-                tArea3x4Path *pPath = vector_iterator_next(&PathsIterator);
                 uint64_t PathExpanded = AREA_3X4_EXPAND_Q(pPath->Path, Index);
-                tSize LookupLength = pPath->Length + BOARD_AREA_LONGEST_PATH(Data & ~PathExpanded, NextIndex, pArea);
+                tSize LookupLength = pPath->Length + (IF Memoize
+                    THEN area_3x4_memo_longest_path(Memo, &MemoSize, Data & ~PathExpanded, NextIndex, pArea)
+                    ELSE BOARD_AREA_LONGEST_PATH(Data & ~PathExpanded, NextIndex, pArea));
 
                 SET_IF_GREATER(LookupLength, MaxPathLength);
             }
@@ -356,6 +328,40 @@ static tSize area_3x4_lookup_longest_path(uint64_t Data, tIndex Index, uint64_t
     return MaxPathLength;
 }
 
+/*
+ * Paths through a quadrant that leave through the same exit often differ only
+ * in squares that cannot be reached from the next quadrant anyway, so the
+ * subproblems are keyed on the area that is still reachable from the entry.
+ */
+static tSize area_3x4_memo_longest_path(tArea3x4Memo *pMemo, tSize *pMemoSize, uint64_t Data, tIndex Index, uint64_t *pArea)
+{
+    uint64_t Reachable = pathfinder_area(Data, Index);
+    tSize Length;
+
+    for (tIndex i = 0; i < *pMemoSize; ++i)
+    {
+        if (pMemo[i].Data == Reachable AND pMemo[i].Index == Index)
+        {
+            Length = pMemo[i].Length;
+            goto Done;
+        }
+    }
+
+    Length = BOARD_AREA_LONGEST_PATH(Reachable, Index, pArea);
+
+    if (*pMemoSize < AREA_3X4_MEMO_SIZE)
+    {
+        tArea3x4Memo *pEntry = &pMemo[(*pMemoSize)++];
+
+        pEntry->Data = Reachable;
+        pEntry->Index = Index;
+        pEntry->Length = Length;
+    }
+
+Done:
+    return Length;
+}
+
 static tSize area_1x1_lookup_longest_path(uint64_t Data, tIndex Index, uint64_t *pArea)
 {
     tSize MaxPathLength = 0;
@@ -377,6 +383,48 @@ static tSize area_1x1_lookup_longest_path(uint64_t Data, tIndex Index, uint64_t
     return MaxPathLength + 1;
 }
 
+/*
+ * The exits and paths of all lookups are kept in two contiguous arrays, so
+ * that the paths of an exit are next to each other in memory.
+ */
+static void area_3x4_add_exit(tArea3x4IndexLookup *pIndexLookup, tIndex Exit, tVector *pPaths)
+{
+    tVectorIterator Iterator;
+    tArea3x4PathLookup *pPathLookup;
+
+    if (Area3x4ExitLookupSize == Area3x4ExitLookupCapacity)
+    {
+        Area3x4ExitLookupCapacity = IF (Area3x4ExitLookupCapacity > 0U) THEN 2U * Area3x4ExitLookupCapacity ELSE AREA_3X4_LOOKUP_SIZE;
+        pArea3x4ExitLookup = erealloc(pArea3x4ExitLookup, Area3x4ExitLookupCapacity * sizeof(tArea3x4PathLookup));
+    }
+
+    pPathLookup = &pArea3x4ExitLookup[Area3x4ExitLookupSize++];
+    pPathLookup->Paths = Area3x4PathLookupSize;
+    pPathLookup->PathCount = vector_size(pPaths);
+    pPathLookup->Exit = Exit;
+
+    pIndexLookup->ExitCount++;
+
+    vector_iterator_init(&Iterator, pPaths);
+
+    while (vector_iterator_has_next(&Iterator))
+    {
+        tArea3x4Path *pPath = vector_iterator_next(&Iterator);
+
+        if (Area3x4PathLookupSize == Area3x4PathLookupCapacity)
+        {
+            Area3x4PathLookupCapacity = IF (Area3x4PathLookupCapacity > 0U) THEN 2U * Area3x4PathLookupCapacity ELSE AREA_3X4_LOOKUP_SIZE;
+            pArea3x4PathLookup = erealloc(pArea3x4PathLookup, Area3x4PathLookupCapacity * sizeof(tArea3x4Path));
+        }
+
+        pArea3x4PathLookup[Area3x4PathLookupSize++] = *pPath;
+
+        free(pPath);
+    }
+
+    vector_free(pPaths);
+}
+
 void area_3x4_get_paths(uint16_t Data, tIndex Start, tIndex End, uint16_t Path, tVector *pPaths)
 {
     BitSet16(&Path, Start);
@@ -875,31 +923,6 @@ static bool area_3x4_subpath_has_longer_through_path(uint16_t Area, uint16_t Pat
     return HasLonger;
 }
 
-static tIndex board_area_exit_index_q0(tIndex Index)
-{
-    return BoardAreaExitIndicesQ0[Index];
-}
-
-static tIndex board_area_exit_index_q1(tIndex Index)
-{
-    return BoardAreaExitIndicesQ1[Index];
-}
-
-static tIndex board_area_exit_index_q2(tIndex Index)
-{
-    return BoardAreaExitIndicesQ2[Index];
-}
-
-static tIndex board_area_exit_index_q3(tIndex Index)
-{
-    return BoardAreaExitIndicesQ3[Index];
-}
-
-static tIndex board_area_exit_index_q4(tIndex Index)
-{
-    return BoardAreaExitIndicesQ4[Index];
-}
-
 static uint64_t area_3x4_expand_q1(uint16_t Data)
 {
     uint64_t E = 0ULL;
@@ -1017,3 +1040,53 @@ static uint16_t area_3x4_contract_q4(uint64_t Data)
          | (C >> 25 & AREA_3x4_MASK_03_05)
          | (C >> 21 & AREA_3x4_MASK_00_02);
 }
+
+/*
+ * Both mappings move each bit of a quadrant to a fixed position, so they are
+ * the union of the mappings of the three nibbles of the quadrant.
+ */
+static uint64_t area_3x4_expand(uint16_t Data, tIndex Quadrant)
+{
+    return Area3x4ExpansionLookup[Quadrant][0][Data & 0xF]
+         | Area3x4ExpansionLookup[Quadrant][1][(Data >> 4) & 0xF]
+         | Area3x4ExpansionLookup[Quadrant][2][Data >> 8];
+}
+
+static uint16_t area_3x4_rotate(uint64_t Data, tIndex Quadrant)
+{
+    uint16_t Contraction = area_3x4_contract_q(Data, Quadrant);
+
+    return Area3x4RotationLookup[Quadrant][0][Contraction & 0xF]
+         | Area3x4RotationLookup[Quadrant][1][(Contraction >> 4) & 0xF]
+         | Area3x4RotationLookup[Quadrant][2][Contraction >> 8];
+}
+
+static uint64_t area_3x4_expand_q(uint16_t Data, tIndex Quadrant)
+{
+    uint64_t Expansion;
+
+    switch (Quadrant)
+    {
+        case 0: Expansion = area_3x4_expand_q1(Data); break;
+        case 1: Expansion = area_3x4_expand_q2(Data); break;
+        case 2: Expansion = area_3x4_expand_q3(Data); break;
+        default: Expansion = area_3x4_expand_q4(Data); break;
+    }
+
+    return Expansion;
+}
+
+static uint16_t area_3x4_contract_q(uint64_t Data, tIndex Quadrant)
+{
+    uint16_t Contraction;
+
+    switch (Quadrant)
+    {
+        case 0: Contraction = area_3x4_contract_q1(Data); break;
+        case 1: Contraction = area_3x4_contract_q2(Data); break;
+        case 2: Contraction = area_3x4_contract_q3(Data); break;
+        default: Contraction = area_3x4_contract_q4(Data); break;
+    }
+
+    return Contraction;
+}
@@ -1,5 +1,5 @@
 #include <errno.h>
-#include <float.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -8,9 +8,10 @@
 
 #include "bitutil.h"
 #include "board.h"
+#include "book.h"
 #include "config.h"
 #include "debug.h"
-#include "mctn.h"
+#include "endgame.h"
 #include "mcts.h"
 #include "rules.h"
 #include "ttt.h"
@@ -18,125 +19,8 @@
 #include "util.h"
 #include "vector.h"
 
-#ifdef SPEED
-#include "scorer.h"
-#endif
-
-static int ttt_get_player_move(tTTT *pGame, bool ComputerPlaying);
 static int ttt_load_moves(tTTT *pGame, tVector *pMoves);
 
-int main(void)
-{
-    int Res = 0;
-
-    tTTT Game;
-    tConfig Config;
-    
-    Res = config_init(&Config);
-    if (Res < 0)
-    {
-        goto Error;
-    }
-
-    Res = config_load(&Config);
-    if (Res < 0)
-    {
-        goto FreeConfig;
-    }
-
-    Res = ttt_init(&Game, &Config);
-    if (Res < 0)
-    {
-        goto FreeConfig;
-    }
-
-#ifdef SPEED
-    scorer_init();
-#endif
-
-    char *pBoardStr, *pMovesStr;
-#ifdef STATS
-    char *pMctsStr;
-#endif
-    int *pMoves;
-    int MovesSize;
-
-    pBoardStr = board_string(&Game.Board);
-    printf("%s\n\n", pBoardStr);
-    free(pBoardStr);
-
-    while (NOT board_finished(&Game.Board))
-    {
-        int Index;
-        bool Player = ttt_get_player(&Game);
-
-        Res = IF (Config.ComputerPlaying AND Player == Config.ComputerPlayer)
-            THEN ttt_get_ai_move(&Game)
-            ELSE ttt_get_player_move(&Game, Config.ComputerPlaying);
-
-        if (Res < 0)
-        {
-            dbg_printf(DEBUG_LEVEL_ERROR, "Failed to get move");
-            goto FreeGame;
-        }
-
-        Index = Res;
-
-#ifdef STATS
-        if (Config.ComputerPlaying AND Game.Mcts.pRoot->Visits > 0)
-        {
-            pMctsStr = mctn_string(Game.Mcts.pRoot);
-            printf("BEFORE SHIFT\n%s\n", pMctsStr);
-            free(pMctsStr);
-
-            float Eval = mcts_evaluate(&Game.Mcts);
-            if (Eval > -FLT_MAX) printf("Eval: %.2f\n\n", Eval);
-        }
-#endif
-
-        ttt_give_move(&Game, Index);
-
-#ifdef STATS
-        if (Config.ComputerPlaying AND Game.Mcts.pRoot->Visits > 0)
-        {
-            pMctsStr = mctn_string(Game.Mcts.pRoot);
-            printf("AFTER SHIFT\n%s\n", pMctsStr);
-            free(pMctsStr);
-
-            float Eval = mcts_evaluate(&Game.Mcts);
-            if (Eval > -FLT_MAX) printf("Eval: %.2f\n\n", Eval);
-        }
-#endif
-
-        pMoves = ttt_get_moves(&Game, &MovesSize);
-        pMovesStr = rules_moves_string(&Game.Rules, pMoves, MovesSize);
-        pBoardStr = board_string(&Game.Board);
-
-        printf("%s\n", pMovesStr);
-        printf("%s\n\n", pBoardStr);
-
-        free(pMoves);
-        free(pMovesStr);
-        free(pBoardStr);
-    }
-
-    int Score = ttt_get_score(&Game);
-    printf("Score: %d\n", Score);
-
-#ifdef SPEED
-    scorer_free();
-#endif
-
-FreeGame:
-    ttt_free(&Game);
-
-FreeConfig:
-    config_free(&Config);
-
-Error:
-    return Res;
-}
-
 int ttt_init(tTTT *pGame, tConfig *pConfig)
 {
     int Res = 0;
@@ -144,8 +28,15 @@ int ttt_init(tTTT *pGame, tConfig *pConfig)
     board_init(&pGame->Board);
     rules_init(&pGame->Rules, &pConfig->RulesConfig);
     mcts_init(&pGame->Mcts, &pGame->Rules, &pGame->Board, &pConfig->MctsConfig);
+    endgame_init(&pGame->Endgame, &pGame->Rules, &pConfig->EndgameConfig);
     memset(&pGame->Moves, 0, sizeof(pGame->Moves));
 
+    Res = book_init(&pGame->Book, &pConfig->RulesConfig, &pConfig->BookConfig);
+    if (Res < 0)
+    {
+        goto Error;
+    }
+
     Res = ttt_load_moves(pGame, &pConfig->StartingMoves);
     if (Res < 0)
     {
@@ -155,6 +46,8 @@ int ttt_init(tTTT *pGame, tConfig *pConfig)
     goto Success;
 
 Error:
+    book_free(&pGame->Book);
+    endgame_free(&pGame->Endgame);
     mcts_free(&pGame->Mcts);
 
 Success:
@@ -163,10 +56,40 @@ Success:
 
 void ttt_free(tTTT *pGame)
 {
+    book_free(&pGame->Book);
+    endgame_free(&pGame->Endgame);
     mcts_free(&pGame->Mcts);
 }
 
+/*
+ * Starts a new game under the rules in pConfig without allocating anything. The
+ * tree and the endgame table are emptied and the book stays mapped. If the
+ * starting moves cannot be loaded, the game is left at the empty board.
+ */
+int ttt_reset(tTTT *pGame, tConfig *pConfig)
+{
+    board_init(&pGame->Board);
+    rules_init(&pGame->Rules, &pConfig->RulesConfig);
+    mcts_reset(&pGame->Mcts, &pGame->Board);
+    endgame_clear(&pGame->Endgame);
+    memset(&pGame->Moves, 0, sizeof(pGame->Moves));
+
+    pGame->Book.RulesType = pConfig->RulesConfig.RulesType;
+
+    return ttt_load_moves(pGame, &pConfig->StartingMoves);
+}
+
 int ttt_get_ai_move(tTTT *pGame)
+{
+    return ttt_search(pGame, pGame->Mcts.Config.Simulations, 0, NULL);
+}
+
+/*
+ * Like ttt_get_ai_move, but the simulations, time, and stop flag limit the
+ * search as in mcts_search. The opening move, the book, and the endgame solver
+ * ignore them.
+ */
+int ttt_search(tTTT *pGame, tVisits Simulations, uint32_t TimeMs, atomic_bool *pStop)
 {
     int Res, Index;
 
@@ -178,14 +101,31 @@ int ttt_get_ai_move(tTTT *pGame)
     }
 
     uint64_t Indices = rules_indices(&pGame->Rules, &pGame->Board, false);
+    int BookIndex = book_lookup(&pGame->Book, &pGame->Board);
 
     if (BitTest64(Indices, 24)) 
     {
         Index = 24;
     } 
+    else if (BookIndex >= 0 AND BitTest64(Indices, BookIndex))
+    {
+        Index = BookIndex;
+    }
+    else if (endgame_active(&pGame->Endgame, &pGame->Board))
+    {
+        tScore Score;
+
+        Res = endgame_solve(&pGame->Endgame, &pGame->Board, &Score);
+        if (Res < 0)
+        {
+            goto Error;
+        }
+
+        Index = Res;
+    }
     else 
     {
-        mcts_simulate(&pGame->Mcts);
+        mcts_search(&pGame->Mcts, Simulations, TimeMs, pStop);
         tBoard *pState = mcts_get_state(&pGame->Mcts);
         if (pState IS NULL)
         {
@@ -248,77 +188,66 @@ int ttt_get_score(tTTT *pGame)
 
 int *ttt_get_moves(tTTT *pGame, int *pSize)
 {
-    *pSize = board_move(&pGame->Board);
+    int *pMoves = emalloc(board_move(&pGame->Board) * sizeof(int));
 
-    int *pMoves = emalloc(*pSize * sizeof(int));
-
-    for (tIndex i = 0; i < *pSize; ++i)
-    {
-        pMoves[i] = pGame->Moves[i];
-    }
+    *pSize = ttt_get_moves_to_buf(pGame, pMoves, board_move(&pGame->Board));
 
     return pMoves;
 }
 
-static int ttt_get_player_move(tTTT *pGame, bool ComputerPlaying)
+/*
+ * Copies the moves played into the buffer and returns how many there are, or
+ * -ENOSPC if the buffer is too small. A buffer of ROWS*COLUMNS holds a whole
+ * game.
+ */
+int ttt_get_moves_to_buf(tTTT *pGame, int *pMoves, int Cap)
 {
-    int Index;
-    bool Player = ttt_get_player(pGame);
-    uint64_t Indices = rules_indices(&pGame->Rules, &pGame->Board, false);
-    char (*pId)[BOARD_ID_STR_LEN] = emalloc(BOARD_ID_STR_LEN * sizeof(char));
+    int Res = board_move(&pGame->Board);
 
-    while (true)
+    if (Res > Cap)
     {
-        if (ComputerPlaying)
-        {
-            printf("Enter move: ");
-        }
-        else
-        {
-            printf("Enter move (Player %d): ", (Player ? 1 : 2));
-        }
-
-        if (fgets(*pId, BOARD_ID_STR_LEN, stdin) ISNOT NULL)
-        {
-            int c; 
-            while ((c = getchar()) != '\n' AND c != EOF);
-
-            if (board_id_valid(pId))
-            {
-                Index = board_id_index(pId);
-
-                if (BitTest64(Indices, Index))
-                {
-                    break;
-                }
-            }
-        }
+        Res = -ENOSPC;
+        goto Error;
     }
 
-    free(pId);
+    for (tIndex i = 0; i < Res; ++i)
+    {
+        pMoves[i] = pGame->Moves[i];
+    }
 
-    return Index;
+Error:
+    return Res;
 }
 
+/*
+ * The moves are played on a copy of the board first, so that the game, its
+ * tree, and its moves are left untouched if any of them is illegal.
+ */
 static int ttt_load_moves(tTTT *pGame, tVector *pMoves)
 {
     int Res = 0;
     tBoard Board;
 
-    board_init(&Board);
     board_copy(&Board, &pGame->Board);
 
     for (tIndex i = 0; i < vector_size(pMoves); ++i)
     {
         tIndex *pMove = vector_get(pMoves, i);
 
-        Res = ttt_give_move(pGame, *pMove);
-        if (Res < 0)
+        if (board_finished(&Board) OR NOT board_index_valid(*pMove)
+            OR NOT BitTest64(rules_indices(&pGame->Rules, &Board, false), *pMove))
         {
-            board_copy(&pGame->Board, &Board);
+            Res = -EINVAL;
             dbg_printf(DEBUG_LEVEL_ERROR, "Failed to load starting moves");
             goto Error;
         }
+
+        board_advance(&Board, *pMove, rules_player(&pGame->Rules, &Board));
+    }
+
+    for (tIndex i = 0; i < vector_size(pMoves) AND Res == 0; ++i)
+    {
+        Res = ttt_give_move(pGame, *(tIndex *) vector_get(pMoves, i));
     }
 
 Error:
@@ -1,10 +1,14 @@
 #ifndef __TTT_H__
 #define __TTT_H__
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "board.h"
+#include "book.h"
 #include "config.h"
+#include "endgame.h"
 #include "mcts.h"
 #include "rules.h"
 #include "types.h"
@@ -14,17 +18,22 @@ typedef struct TTT
     tBoard Board;
     tRules Rules;
     tMcts Mcts;
+    tEndgame Endgame;
+    tBook Book;
     tIndex Moves[ROWS*COLUMNS];
 }
 tTTT;
 
 int ttt_init(tTTT *pGame, tConfig *pConfig);
 void ttt_free(tTTT *pGame);
+int ttt_reset(tTTT *pGame, tConfig *pConfig);
 int ttt_get_ai_move(tTTT *pGame);
+int ttt_search(tTTT *pGame, tVisits Simulations, uint32_t TimeMs, atomic_bool *pStop);
 int ttt_give_move(tTTT *pGame, int Index);
 bool ttt_get_player(tTTT *pGame);
 bool ttt_finished(tTTT *pGame);
 int ttt_get_score(tTTT *pGame);
 int *ttt_get_moves(tTTT *pGame, int *pSize);
+int ttt_get_moves_to_buf(tTTT *pGame, int *pMoves, int Cap);
 
 #endif
@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,3 +30,41 @@ void *erealloc(void *pMemory, size_t Size)
 
     return pMemory;
 }
+
+/*
+ * Appends to the string of the given length in the buffer, which stays
+ * terminated. Returns -ENOSPC, keeping what fits, if the buffer is too small.
+ */
+int bprintf(char *pBuf, size_t Cap, size_t *pLength, const char *pFormat, ...)
+{
+    int Res = 0, Written;
+    va_list Args;
+
+    if (*pLength >= Cap)
+    {
+        Res = -ENOSPC;
+        goto Error;
+    }
+
+    va_start(Args, pFormat);
+    Written = vsnprintf(pBuf + *pLength, Cap - *pLength, pFormat, Args);
+    va_end(Args);
+
+    if (Written < 0)
+    {
+        Res = -EINVAL;
+        goto Error;
+    }
+
+    if ((size_t) Written >= Cap - *pLength)
+    {
+        Res = -ENOSPC;
+        *pLength = Cap - 1;
+        goto Error;
+    }
+
+    *pLength += Written;
+
+Error:
+    return Res;
+}
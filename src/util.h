@@ -35,5 +35,6 @@
 
 void *emalloc(size_t Size);
 void *erealloc(void *pMemory, size_t Size);
+int bprintf(char *pBuf, size_t Cap, size_t *pLength, const char *pFormat, ...) __attribute__((format(printf, 4, 5)));
 
 #endif